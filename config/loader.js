@@ -12,6 +12,9 @@ var Loader =
                                      context.hashChange();
                                      context.insertContent()};
     this.requestData();
+    // Values that change on their own are pushed by the host, not polled.
+    wsSubscribe("io.*.state", 200);
+    wsSubscribe("host.*", 5000);
     this.loadFile(this.selected_file);
     this.loadFilenames();
     ws_receive_callbacks.push(
@@ -337,6 +340,12 @@ var Loader =
   requestData : function(){
     var summary = {_subject: "hosts/_all",
                    _command: "learn_all"};
+    if(ws_generation !== undefined){
+      // Only the tags changed since the last complete "learn_all".
+      summary._command = "learn_since";
+      summary.generation = ws_generation.generation;
+      summary.epoch = ws_generation.epoch;
+    }
     wsQueueSend(summary);
   },
 
@@ -371,8 +380,12 @@ var Loader =
         }
         var summary = {_subject: topic,
                        _command: "update",
-                       path: name,
                        value: value};
+        if(ws_path_ids[name] !== undefined){
+          summary.path_id = ws_path_ids[name];
+        } else {
+          summary.path = name;
+        }
         wsQueueSend(summary);
         console.log(name, valueAtPath(name), value, elements[i].type);
       }
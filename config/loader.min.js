@@ -1,6 +1,6 @@
 var Loader={files:{},selected_file:"index.mustache",insert_content_timer:void 0,insert_content_callback_timer:void 0,init:function(){this.hashChange()
 var e=this
-window.onhashchange=function(){console.log("hash change"),e.hashChange(),e.insertContent()},this.requestData(),this.loadFile(this.selected_file),this.loadFilenames(),ws_receive_callbacks.push(function(t){e.insertContent(t)})},hashChange:function(){console.log(window.location.hash)
+window.onhashchange=function(){console.log("hash change"),e.hashChange(),e.insertContent()},this.requestData(),wsSubscribe("io.*.state",200),wsSubscribe("host.*",5e3),this.loadFile(this.selected_file),this.loadFilenames(),ws_receive_callbacks.push(function(t){e.insertContent(t)})},hashChange:function(){console.log(window.location.hash)
 var e=window.location.hash,t=e.indexOf("filename=")
 if(t>0){t+="filename=".length
 var n=e.indexOf("&")
@@ -42,11 +42,12 @@ if(0===u.length||"0"===u||""===u){var v={line:t,pos:n},m=t,_=n,w=e[h+1]
 path=a.concat(c.name.split(".")),v=this.contentChunk(c.children,m,_,i,s,path,w.line,w.pos,r.concat(0)),s.push(""),t=v.line,n=v.pos}else{var g=e[h+1]
 void 0!==g&&(t=g.line,n=g.pos)}}else n+=5}for(var f=t;f<o;f++)0===n&&s.push(""),s[s.length-1]+=f===o?i[f].substring(n,l):i[f].substring(n,i[f].length),n=0
 return{line:o,pos:n}},tagContent:function(e,t){for(var n=ws_data,i=0,s="",a=0;a<e.length;a++){if(n instanceof Array&&(n=n[t[i]],s+=t[i],s+=".",i++),s+=e[a],s+=".",void 0===n||void 0===n[e[a]])return s.endsWith("_path.")&&s.split("_path.").length>1?s.split("_path.")[0]:"(XXXX)"
-n=n[e[a]]}return n},requestData:function(){var e={_subject:"hosts/_all",_command:"learn_all"}
+n=n[e[a]]}return n},requestData:function(){var e={_subject:"hosts/_all",_command:"learn_all"};void 0!==ws_generation&&(e._command="learn_since",e.generation=ws_generation.generation,e.epoch=ws_generation.epoch)
 wsQueueSend(e)},saveChanges:function(){for(var e=document.getElementsByClassName("monitor_changes"),t=0;t<e.length;t++){var n=e[t].name
 if(void 0===n||""===n)for(var i=0;i<e[t].classList.length;i++)if("monitor_changes"!==e[t].classList[i]){n=e[t].classList[i]
 break}var s=e[t].value
 if("checkbox"===e[t].type&&(s=1*e[t].checked),void 0!==s&&void 0!==valueAtPath(n)&&""+s!==valueAtPath(n)){var a
-try{a=ws_data.host.mqtt.publish_prefix,a+="/hosts/",a+=ws_data.host.hostname}catch(e){a=""}var o={_subject:a,_command:"update",path:n,value:s}
+try{a=ws_data.host.mqtt.publish_prefix,a+="/hosts/",a+=ws_data.host.hostname}catch(e){a=""}var o={_subject:a,_command:"update",value:s}
+void 0!==ws_path_ids[n]?o.path_id=ws_path_ids[n]:o.path=n
 wsQueueSend(o),console.log(n,valueAtPath(n),s,e[t].type)}}}}
 window.addEventListener("load",function(){wsInit(),Loader.init()},!1)
@@ -9,6 +9,11 @@ var wsMessages = {};
 var wsMessagesTimer;
 var ws_receive_callbacks = [];
 var ws_data = {};
+var ws_path_ids = {};  // Compact "path_id" of each path learnt from "teach".
+var ws_frame_sessions = {};   // Frames arrived from each of the host's sync sessions.
+var ws_generation;            // "generation" and "epoch" of the last "teach_done".
+var ws_subscriptions = {};    // Minimum interval between pushes of each pattern.
+var WS_SUBSCRIBE_RENEW = 60 * 1000;  // Well inside the host's TAG_SUBSCRIBE_TTL.
 
 if(localStorage.esp8266_kitchensink === ""){
   localStorage.esp8266_kitchensink = "{}";
@@ -16,6 +21,9 @@ if(localStorage.esp8266_kitchensink === ""){
   console.log(localStorage.esp8266_kitchensink);
   ws_data = JSON.parse(localStorage.esp8266_kitchensink);
 }
+if(localStorage.esp8266_kitchensink_generation){
+  ws_generation = JSON.parse(localStorage.esp8266_kitchensink_generation);
+}
 
 function wsCodes(value){
   var codes = ["CONNECTING", "OPEN", "CLOSING", "CLOSED"];
@@ -46,7 +54,8 @@ function parsePayload(payload, log){
 
 function setIo(){
   console.log(this);
-  var payload = {_command: !Boolean(parseInt(this.value)),
+  // Let the device toggle its own state so clicks from two clients can not race.
+  var payload = {_command: "toggle",
                  _subject: this.topic};
   console.log(payload);
   wsQueueSend(payload);
@@ -55,6 +64,14 @@ function setIo(){
 function updatePage(payload){
   var class_key = "";
 
+  if(payload._devices){
+    // Aggregated announcement from a "group" command.
+    for(var i=0; i < payload._devices.length; i++){
+      updatePage(payload._devices[i]);
+    }
+    return;
+  }
+
   if(payload._iopin){
     class_key = "ws_iopin_" + payload._iopin + "_zero";
     for(var i=0; i < document.getElementsByClassName(class_key).length; i++){
@@ -133,6 +150,98 @@ function wsCleanup(){
   }
 }
 
+// Merge one tag from a "teach" or "teach_frame" message into ws_data.
+function learnTag(payload){
+  var container = ws_data;
+  var path = payload.name.split(".");
+  console.log(path.join("."));
+
+  for(var i = 0; i < path.length; i++){
+    var depth;
+    var name = path[i];
+    if(parseInt(path[i +1], 10).toString() === path[i +1]){
+      depth = parseInt(path[i +1], 10);
+      i++;
+    } else {
+      depth = undefined;
+    }
+
+    if(i < path.length -1){
+      if(typeof(container[name]) !== "object"){
+        if(depth === undefined){
+          container[name] = {};
+        } else {
+          container[name] = [];
+        }
+      }
+    } else if(container[name] === undefined ||
+        typeof(container[name]) === "string")
+    {
+      container[name] = payload.content;
+    }
+
+    if(depth === undefined){
+      container = container[name];
+    } else {
+      if(!container.hasOwnProperty(name)){
+        container[name] = [];
+      }
+      if(!container[name].hasOwnProperty(depth)){
+        container[name][depth] = {};
+      }
+      container = container[name][depth];
+    }
+  }
+
+  for(var j = 0; j < ws_receive_callbacks.length; j++){
+    ws_receive_callbacks[j](path);
+  }
+
+  if(payload.path_id !== undefined){
+    ws_path_ids[payload.name] = payload.path_id;
+  }
+}
+
+// Record the arrival of a "teach_frame" and build the "ack" for it: the last
+// of the frames that have all arrived plus a bitmap of the 32 after the next.
+// Frames before "base" are no longer being sent so need not be waited for.
+// Each of the host's sync sessions numbers its frames separately.
+function frameAck(session, frame, base){
+  var state = ws_frame_sessions[session];
+  if(state === undefined || base < state.base){
+    // New session, or the host has restarted.
+    state = {cumulative: 0, base: 0, received: {}};
+    ws_frame_sessions[session] = state;
+  }
+  state.base = base;
+  if(state.cumulative < base -1){
+    state.cumulative = base -1;
+  }
+
+  state.received[frame] = true;
+  while(state.received[state.cumulative +1]){
+    state.cumulative++;
+  }
+  for(var received in state.received){
+    if(received <= state.cumulative){
+      delete state.received[received];
+    }
+  }
+
+  var sack = 0;
+  for(var i = 0; i < 32; i++){
+    if(state.received[state.cumulative +2 +i]){
+      sack |= (1 << i);
+    }
+  }
+
+  return {_command: "ack",
+          session: session,
+          frame: state.cumulative,
+          sack: sack >>> 0,
+          _subject: "hosts/_all"};
+}
+
 function wsStart(){
   if((Date.now() - ws_start_timer) < MAX_TIME){
     return;
@@ -166,6 +275,7 @@ function wsStart(){
     var message = {_command: "solicit",
                    _subject : solicit_topic};
     wsQueueSend(message);
+    wsRenewSubscriptions();
 	};
 
   websocket.onmessage = function(evt) {
@@ -179,59 +289,41 @@ function wsStart(){
         // Remove Incoming message if it is a reply to one in the send queue.
         wsDeQueue(payload);
 
-        var container = ws_data;
-        var path = payload.name.split(".");
-        console.log(path.join("."));
-
-        for(var i = 0; i < path.length; i++){
-          var depth;
-          var name = path[i];
-          if(parseInt(path[i +1], 10).toString() === path[i +1]){
-            depth = parseInt(path[i +1], 10);
-            i++;
-          } else {
-            depth = undefined;
-          }
-
-          if(i < path.length -1){
-            if(typeof(container[name]) !== "object"){
-              if(depth === undefined){
-                container[name] = {};
-              } else {
-                container[name] = [];
-              }
-            }
-          } else if(container[name] === undefined ||
-              typeof(container[name]) === "string")
-          {
-            container[name] = payload.content;
-          }
-
-          if(depth === undefined){
-            container = container[name];
-          } else {
-            if(!container.hasOwnProperty(name)){
-              container[name] = [];
-            }
-            if(!container[name].hasOwnProperty(depth)){
-              container[name][depth] = {};
-            }
-            container = container[name][depth];
-          }
-        }
-
+        learnTag(payload);
         localStorage.esp8266_kitchensink = JSON.stringify(ws_data);
 
-        for(var j = 0; j < ws_receive_callbacks.length; j++){
-          ws_receive_callbacks[j](path);
-        }
-
         var message = {_command: "ack",
                        path : payload.name,
+                       path_id: payload.path_id,
                        id: payload.id,
                        sequence: payload.sequence,
                        _subject: "hosts/_all"};
         wsQueueSend(message);
+      } else if(payload._command === "teach_frame"){
+        // Many tags in one message. Acknowledged as a whole by "frame".
+        for(var t = 0; t < payload.tags.length; t++){
+          learnTag(payload.tags[t]);
+        }
+        localStorage.esp8266_kitchensink = JSON.stringify(ws_data);
+
+        wsQueueSend(frameAck(payload.session, payload.frame, payload.base));
+      } else if(payload._command === "notify"){
+        // Pushed by a subscription. Not acknowledged.
+        for(var n = 0; n < payload.tags.length; n++){
+          learnTag(payload.tags[n]);
+        }
+        localStorage.esp8266_kitchensink = JSON.stringify(ws_data);
+      } else if(payload._command === "teach_done"){
+        delete ws_frame_sessions[payload.session];
+        // Another client's "learn_since" may have skipped tags this one lacks.
+        if(payload.since === 0 ||
+            (ws_generation !== undefined && ws_generation.epoch === payload.epoch &&
+             ws_generation.generation >= payload.since))
+        {
+          // ws_data is complete as of this generation.
+          ws_generation = {generation: payload.generation, epoch: payload.epoch};
+          localStorage.esp8266_kitchensink_generation = JSON.stringify(ws_generation);
+        }
       }
     }
   };
@@ -285,8 +377,25 @@ function wsInit() {
   ws_data_timer = Date.now();
   wsStart();
   window.setInterval(wsCheck, KEEPALIVE_TIME);
+  window.setInterval(wsRenewSubscriptions, WS_SUBSCRIBE_RENEW);
 };
 
+// Have the host push tags matching pattern as they change, no more often than
+// every interval milliseconds. eg. "io.*.state".
+function wsSubscribe(pattern, interval){
+  ws_subscriptions[pattern] = interval;
+  wsQueueSend({_command: "subscribe",
+               pattern: pattern,
+               interval: interval,
+               _subject: "hosts/_all"});
+}
+
+function wsRenewSubscriptions(){
+  for(var pattern in ws_subscriptions){
+    wsSubscribe(pattern, ws_subscriptions[pattern]);
+  }
+}
+
 function wsQueueSend(message){
   //console.log("wsQueueSend(", message, ")", message.name, wsMessagesTimer);
 
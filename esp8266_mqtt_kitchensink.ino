@@ -28,7 +28,9 @@
 #include "FS.h"
 
 #include "src/devices.h"
+#include "src/expander.h"
 #include "src/mqtt.h"
+#include "src/message_parsing.h"
 #include "src/ipv4_helpers.h"
 #include "src/secrets.h"
 #include "src/mdns_actions.h"
@@ -86,14 +88,17 @@ void mqttCallback(const char* topic, const byte* payload, const unsigned int len
 // IO
 Io io;
 
-// TagRoot's children can service requests for system data. Used in response
+#if EXPANDER_TYPE == EXPANDER_MCP23017
+Mcp23017Bus expander_bus(EXPANDER_I2C_ADDRESS, EXPANDER_INT_PIN);
+Expander expander(&expander_bus);
+#elif EXPANDER_TYPE == EXPANDER_74HC595
+ShiftRegisterBus expander_bus(EXPANDER_DATA_PIN, EXPANDER_CLOCK_PIN, EXPANDER_LATCH_PIN);
+Expander expander(&expander_bus);
+#endif
+
+// The tag tree services requests for system data. Used in response
 // to network requests for specific data.
-TagRoot root_tag(&config, &brokers, &my_mdns, &mqtt, &io);
-TagItterator tag_itterator(root_tag);
-std::function< void(String&, String&) > tag_itterator_callback = nullptr;
-TagBase* tag_to_process;
-TaqQueue tag_queue;
-uint16_t TagBase::id_counter = 0;
+TagItterator tag_itterator;  // For getByPath(). learn_all runs in a TagSyncSession.
 
 // Web page configuration interface.
 HttpServer http_server((char*)buffer, BUFFER_SIZE, &config, &brokers,
@@ -255,6 +260,8 @@ void setup(void) {
   Serial.println("Reset.");
   Serial.println();
 
+  TagHandler::setContext(&config, &brokers, &my_mdns, &mqtt, &io);
+  tag_epoch = (uint32_t)secureRandom(UINT32_MAX);
   config.load("/config.cfg");
     
 
@@ -266,6 +273,9 @@ void setup(void) {
     pinMode(config.enableiopin, INPUT_PULLUP);
     attachInterrupt(digitalPinToInterrupt(config.enableiopin), configInterrupt, CHANGE);
     io.registerCallback([]() {io.inputCallback();});  // Inline callback function.
+#if EXPANDER_TYPE != EXPANDER_NONE
+    io.registerExpander(&expander);
+#endif
     io.setup();
     
     setup_network();
@@ -278,8 +288,6 @@ void setup(void) {
     }
 
     mqtt.registerCallback(mqttCallback);
-
-    tag_to_process = nullptr;
   }
   Serial.println("done setup");
 }
@@ -294,36 +302,27 @@ void loop(void) {
     if(result){
 			Serial.println("Upgrade successful.");
     }
+    mqtt.forceDisconnect();
 		ESP.reset();
   } else {
     mqtt.loop();
+    mqtt.dispatchCommands();
+    sendDeferredResponses(&io, &config);
     io.loop();
     my_mdns.loop();
     http_server.loop();
     webSocket.loop();
 
-    String topic;
-    String payload;
+    const char* topic;
+    const char* payload;
     while(io.getOutput(topic, payload)){
       webSocket.publish(topic, payload);
       mqtt.publish(topic, payload);
+      tags[tag_io_state].touch();
     }
 
-    if(tag_to_process == nullptr){
-      tag_to_process = tag_itterator.loop();
-    }
-    if(tag_to_process != nullptr){
-      if(tag_queue.push(tag_to_process)){
-        tag_to_process = nullptr;
-      }
-    }
-    TagBase* tag_to_send = tag_queue.peek();
-    if(tag_to_send != nullptr){
-      if(!tag_to_send->sendData(tag_itterator_callback)){
-        // Tag does not need sending so remove it from the queue now.
-        Serial.print("* ");
-        tag_queue.dequeue(tag_to_send);
-      }
-    }
+    tagSyncLoop();
+    sampleDynamicTags();
+    pushSubscriptions();
   }
 }
@@ -26,8 +26,60 @@
 // Reset if unable to connect to WiFi after this many seconds.
 #define RESET_ON_CONNECT_FAIL 20
 
-// Maximum number of devices connected to IO pins.
-#define MAX_DEVICES 4
+// Maximum number of devices connected to IO pins. No more than 32.
+#define MAX_DEVICES 16
+
+// Space shared by the address segments of all devices.
+// Segments common to several devices are only stored once.
+#define SEGMENT_POOL_LEN (MAX_DEVICES * 24)
+
+// Optional IO expander providing virtual pins EXPANDER_PIN_BASE and up.
+// One of EXPANDER_NONE, EXPANDER_MCP23017 or EXPANDER_74HC595.
+#define EXPANDER_NONE 0
+#define EXPANDER_MCP23017 1
+#define EXPANDER_74HC595 2
+#define EXPANDER_TYPE EXPANDER_NONE
+#define EXPANDER_PIN_BASE 100
+#define EXPANDER_PINS 16
+
+// MCP23017 wiring.
+#define EXPANDER_I2C_ADDRESS 0x20
+#define EXPANDER_SDA_PIN 4
+#define EXPANDER_SCL_PIN 5
+#define EXPANDER_INT_PIN 12
+
+// 74HC595 wiring.
+#define EXPANDER_DATA_PIN 13
+#define EXPANDER_CLOCK_PIN 14
+#define EXPANDER_LATCH_PIN 15
+
+// Maximum number of local rules binding inputs to outputs.
+#define MAX_RULES 8
+
+// Initial size of the JSON buffer config.cfg is parsed into. Only the
+// structure counts as strings are parsed in place. One object for each
+// device and rule plus the nested host, session and server settings.
+#define CONFIG_JSON_BUFFER (JSON_OBJECT_SIZE(8) * 12 + \
+    JSON_ARRAY_SIZE(MAX_DEVICES) + MAX_DEVICES * JSON_OBJECT_SIZE(9) + \
+    JSON_ARRAY_SIZE(MAX_RULES) + MAX_RULES * JSON_OBJECT_SIZE(6))
+
+// Typical length of config.cfg as written by Config::save().
+#define CONFIG_FILE_LEN (1024 + MAX_DEVICES * 320 + MAX_RULES * 160)
+
+// Maximum number of {"_subject", "_command"} pairs in one "group" command.
+#define MAX_GROUP_COMMANDS 6
+// Typical length of one of those pairs.
+#define GROUP_COMMAND_LEN 64
+
+// Longest inbound command: a full "group" plus room for its other keys.
+// PubSubClient's buffer, the MQTT command queue and the JSON buffer are all
+// sized from this so a command that fits one fits them all.
+#define COMMAND_PAYLOAD_LEN (64 + (MAX_GROUP_COMMANDS * GROUP_COMMAND_LEN))
+
+// Size of the JSON buffer incoming commands are parsed into.
+// Commands are parsed in place so only the structure counts.
+#define MESSAGE_JSON_BUFFER (JSON_OBJECT_SIZE(8) + JSON_ARRAY_SIZE(MAX_GROUP_COMMANDS) + \
+                             (MAX_GROUP_COMMANDS * JSON_OBJECT_SIZE(2)))
 
 // Maximum number of subscriptions to MQTT.
 #define MAX_SUBSCRIPTIONS 10
@@ -64,6 +116,83 @@
 // Maximum length of a MQTT topic.
 #define MAX_TOPIC_LENGTH  (PREFIX_LEN + ((NAME_LEN +1) * ADDRESS_SEGMENTS) +1)
 
+// Number of analog input samples averaged for each filtered value.
+#define ANALOG_RING_LEN 8
+
+// Milliseconds between analog input samples if none is configured.
+#define ANALOG_SAMPLE_INTERVAL 100
+
+// Maximum number of devices of Io_Type::counter.
+#define MAX_COUNTERS 4
+
+// Pulse counters calculate their rate over this many seconds.
+#define COUNTER_WINDOW 10
+
+// Milliseconds between pulse counter announcements if none is configured.
+#define COUNTER_INTERVAL 60000
+
+// Maximum number of rotary encoder devices.
+#define MAX_ENCODERS 2
+
+// Default minimum milliseconds between announcements of an encoder's position.
+#define ENCODER_INTERVAL 250
+
+// Maximum number of ds18b20 and dht22 devices.
+#define MAX_SENSORS 4
+
+// Default milliseconds between sensor readings.
+#define SENSOR_SAMPLE_INTERVAL 10000
+
+// A DHT22 can not be read more often than this many milliseconds.
+#define DHT22_MIN_INTERVAL 2000
+
+// Give up on a DHT22 that has not replied within this many milliseconds.
+#define DHT22_TIMEOUT 20
+
+// Longest, in microseconds, a single step of a sensor reading should take.
+// Longer steps are counted as overruns.
+#define SENSOR_STEP_BUDGET_US 1500
+
+// Offset into RTC user memory, in 4 byte blocks, of data that should survive
+// a soft reset. OTA updates use the first 128 bytes.
+#define RTC_OFFSET 32
+
+// Default minimum milliseconds between announcements of one device.
+// Changes in between are coalesced and the latest state sent when the time is up.
+#define ANNOUNCE_RATE_LIMIT 50
+
+// Size of PubSubClient's buffer. Big enough to receive any command that fits
+// COMMAND_PAYLOAD_LEN. Messages bigger than this are streamed straight to the
+// socket instead.
+#define MQTT_BUFFER_SIZE (5 + 2 + MAX_TOPIC_LENGTH + COMMAND_PAYLOAD_LEN)
+
+// Bytes copied at a time when streaming an MQTT payload.
+#define MQTT_STREAM_CHUNK 64
+
+// Default milliseconds over which a fleet of hosts spread their answers to a
+// "solicit" or "learn_all" sent to every host. Each host waits a fixed
+// fraction of this, derived from its MAC address.
+#define SOLICIT_WINDOW 5000
+
+// Inbound MQTT messages are queued by the PubSubClient callback and acted on
+// later from the main loop.
+#define COMMAND_QUEUE_LEN 4
+
+// Milliseconds per loop spent acting on queued MQTT messages.
+// At least one message is always dispatched.
+#define COMMAND_DISPATCH_BUDGET 20
+
+// Pre-rendered "_announce" payloads keep the state and pin in fixed width
+// slots so they can be updated without re-rendering the whole payload.
+// Slot width is the quotes plus the longest number that can go in it.
+#define ANNOUNCE_STATE_LEN (2 + 11)
+#define ANNOUNCE_PIN_LEN (2 + 3)
+#define ANNOUNCE_PAYLOAD_LEN (80 + ((NAME_LEN +1) * ADDRESS_SEGMENTS))
+
+// Space shared by the pre-rendered "_announce" payloads of all devices.
+// Sized for a typical address. Payloads that do not fit are rendered on demand.
+#define ANNOUNCE_BUFFER_LEN (MAX_DEVICES * 96)
+
 // mDNS service_type for MQTT Broker.
 #define QUESTION_SERVICE "_mqtt._tcp.local"
 
@@ -38,6 +38,16 @@ void Connected_device::setType(const String& type){
     io_type = Io_Type::inputpullup;
   } else if (type == "timer") {
     io_type = Io_Type::timer;
+  } else if (type == "analog") {
+    io_type = Io_Type::analog;
+  } else if (type == "counter") {
+    io_type = Io_Type::counter;
+  } else if (type == "ds18b20") {
+    io_type = Io_Type::ds18b20;
+  } else if (type == "dht22") {
+    io_type = Io_Type::dht22;
+  } else if (type == "encoder") {
+    io_type = Io_Type::encoder;
   } else {
     io_type = Io_Type::test;
   }
@@ -53,6 +63,30 @@ void Connected_device::setInverted(const String& value){
   }
 }
 
+void Rule::setTrigger(const String& trigger_){
+  if(trigger_ == "on"){
+    trigger = trigger_on;
+  } else if(trigger_ == "off"){
+    trigger = trigger_off;
+  } else {
+    trigger = trigger_change;
+  }
+}
+
+void Rule::setAction(const String& action_){
+  if(action_ == "toggle"){
+    action = action_toggle;
+  } else if(action_ == "set"){
+    action = action_set;
+  } else if(action_ == "pulse"){
+    action = action_pulse;
+  } else if(action_ == "follow"){
+    action = action_follow;
+  } else {
+    action = action_none;
+  }
+}
+
 // Ensure buffer contains only valid characters for a word in an MQTT topic.
 void sanitizeTopicSection(char* buffer){
   bool wildcard_found = false;
@@ -104,15 +138,53 @@ void sanitizeTopic(char* buffer){
   }
 }
 
+uint16_t Segment_Pool::intern(const char* segment_){
+  if(segment_[0] == '\0'){
+    return 0;
+  }
+  if(used == 0){
+    // Offset 0 is reserved for the empty string.
+    pool[0] = '\0';
+    used = 1;
+  }
+  for(uint16_t offset = 1; offset < used; offset += strlen(pool + offset) +1){
+    if(strcmp(pool + offset, segment_) == 0){
+      return offset;
+    }
+  }
+  const uint16_t len = strlen(segment_) +1;
+  if(used + len > SEGMENT_POOL_LEN){
+    return 0;
+  }
+  const uint16_t offset = used;
+  memcpy(pool + offset, segment_, len);
+  used += len;
+  return offset;
+}
+
+void Segment_Pool::compact(){
+  char old_pool[SEGMENT_POOL_LEN];
+  memcpy(old_pool, pool, SEGMENT_POOL_LEN);
+  used = 0;
+  for(int i = 0; i < MAX_DEVICES; i++){
+    for(int j = 0; j < ADDRESS_SEGMENTS; j++){
+      uint16_t& offset = config.devices[i].address[j];
+      if(offset > 0){
+        offset = intern(old_pool + offset);
+      }
+    }
+  }
+}
+
 // Return MQTT address of a device.
 String DeviceAddress(const Connected_device& device) {
   String return_value = "";
   for(int i = 0; i < ADDRESS_SEGMENTS; i++){
-    if(strlen(device.address_segment[i].segment) > 0){
+    if(device.address[i] > 0){
       if(i > 0){
         return_value += "/";
       }
-      return_value += device.address_segment[i].segment;
+      return_value += config.segments.segment(device.address[i]);
     } else {
       break;
     }
@@ -120,21 +192,49 @@ String DeviceAddress(const Connected_device& device) {
   return return_value;
 }
 
-void DeviceAddressSet(Connected_device& device, const String& address){
+const char* DeviceSegment(const Connected_device& device, const uint8_t segment){
+  if(segment >= ADDRESS_SEGMENTS){
+    return "";
+  }
+  return config.segments.segment(device.address[segment]);
+}
+
+void DeviceAddressSet(const unsigned int index, const String& address){
+  if(index >= MAX_DEVICES){
+    return;
+  }
+  Connected_device& device = config.devices[index];
+
+  // Release the old address first so compacting the pool can reclaim it.
+  memset(device.address, 0, sizeof(device.address));
+
   uint8_t address_tail = 0;
   uint8_t address_head = 0;
   uint8_t segment = 0;
+  char address_section[NAME_LEN];
   while(address_tail < address.length() && segment < ADDRESS_SEGMENTS){
     address_head = address.indexOf("/", address_tail) +1;
     if(address_head == 0){
       address_head = address.length() +1;
     }
-    char* address_section = device.address_segment[segment].segment;
     address.substring(address_tail, address_head -1).toCharArray(address_section, NAME_LEN);
     sanitizeTopicSection(address_section);
+    if(address_section[0] != '\0'){
+      uint16_t offset = config.segments.intern(address_section);
+      if(offset == 0){
+        config.segments.compact();
+        offset = config.segments.intern(address_section);
+      }
+      if(offset == 0){
+        Serial.println("Error. Address segment pool full.");
+        break;
+      }
+      device.address[segment++] = offset;
+    }
     address_tail = address_head;
-    segment++;
   }
+
+  config.setDeviceInUse(index, device.address[0] > 0);
 }
 
 // The part of the MQTT topic that is common to all messages on this device.
@@ -148,24 +248,515 @@ void SetPrefix(const char* new_prefix, char* dest_buffer) {
 void SetDevice(const unsigned int index, struct Connected_device& device) {
   if (index < MAX_DEVICES) {
     memcpy(&(config.devices[index]), &device, sizeof(device));
+    config.setDeviceInUse(index, device.address[0] > 0);
+  }
+}
+
+
+// Pulse counts are incremented by interrupt handlers, one per counter slot.
+static volatile uint32_t pulse_count[MAX_COUNTERS];
+
+template<uint8_t slot>
+void ICACHE_RAM_ATTR onPulse(){
+  pulse_count[slot]++;
+}
+
+static void (* const pulse_handlers[MAX_COUNTERS])() = {
+  onPulse<0>, onPulse<1>, onPulse<2>, onPulse<3>
+};
+static_assert(MAX_COUNTERS == 4, "pulse_handlers needs one entry per counter.");
+
+// Encoder positions are updated by interrupt handlers, one per encoder slot.
+static volatile int32_t encoder_position[MAX_ENCODERS];
+static volatile uint8_t encoder_state[MAX_ENCODERS];  // Last 2 readings of both pins.
+static uint8_t encoder_pins[MAX_ENCODERS][2];
+
+// Step for each combination of previous and current pin readings.
+// 0 for no movement or an impossible transition (a missed edge).
+static const int8_t quadrature_steps[16] = {
+  0, -1,  1,  0,
+  1,  0,  0, -1,
+ -1,  0,  0,  1,
+  0,  1, -1,  0
+};
+
+template<uint8_t slot>
+void ICACHE_RAM_ATTR onEncoder(){
+  const uint8_t state = ((encoder_state[slot] << 2) |
+                         (digitalRead(encoder_pins[slot][0]) << 1) |
+                         digitalRead(encoder_pins[slot][1])) & 0x0F;
+  encoder_state[slot] = state;
+  encoder_position[slot] += quadrature_steps[state];
+}
+
+static void (* const encoder_handlers[MAX_ENCODERS])() = {
+  onEncoder<0>, onEncoder<1>
+};
+static_assert(MAX_ENCODERS == 2, "encoder_handlers needs one entry per encoder.");
+
+static uint32_t crc32(const uint8_t* data, size_t len){
+  uint32_t crc = 0xffffffff;
+  while(len--){
+    crc ^= *data++;
+    for(uint8_t bit = 0; bit < 8; bit++){
+      crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+    }
+  }
+  return ~crc;
+}
+
+static_assert(RTC_OFFSET * 4 + sizeof(Rtc_State) <= 512, "Rtc_State does not fit in RTC user memory.");
+
+// Returns false if there was nothing valid to load.
+bool Io::rtcLoad(){
+  ESP.rtcUserMemoryRead(RTC_OFFSET, (uint32_t*)&rtc_state, sizeof(rtc_state));
+  if(ESP.getResetInfoPtr()->reason == REASON_DEFAULT_RST ||
+      rtc_state.crc != crc32((uint8_t*)&rtc_state + sizeof(rtc_state.crc),
+                             sizeof(rtc_state) - sizeof(rtc_state.crc)))
+  {
+    // Power on reset or corrupt.
+    Serial.println("No valid state in RTC memory.");
+    memset(&rtc_state, 0, sizeof(rtc_state));
+    for(uint8_t slot = 0; slot < MAX_COUNTERS; slot++){
+      rtc_state.counter_device[slot] = -1;
+    }
+    return false;
   }
+  return true;
 }
 
+void Io::rtcSave(){
+  rtc_state.crc = crc32((uint8_t*)&rtc_state + sizeof(rtc_state.crc),
+                        sizeof(rtc_state) - sizeof(rtc_state.crc));
+  ESP.rtcUserMemoryWrite(RTC_OFFSET, (uint32_t*)&rtc_state, sizeof(rtc_state));
+}
+
+// Note an output's value so it can be restored after a soft reset.
+// Written to RTC memory at the end of Io::loop().
+void Io::rtcRecord(const Connected_device& device){
+  const int index = &device - config.devices;
+  if(index < 0 || index >= MAX_DEVICES){
+    return;
+  }
+  if(rtc_state.output_type[index] != device.io_type ||
+      rtc_state.output_pin[index] != device.iopin ||
+      rtc_state.output_value[index] != device.io_value)
+  {
+    rtc_state.output_type[index] = device.io_type;
+    rtc_state.output_pin[index] = device.iopin;
+    rtc_state.output_value[index] = device.io_value;
+    rtc_dirty = true;
+  }
+}
+
+void Io::setupCounters(){
+  uint8_t slot = 0;
+  for(int i=0; i < MAX_DEVICES; i++){
+    Connected_device& device = config.devices[i];
+    if(device.io_type != counter || !config.deviceInUse(i)){
+      continue;
+    }
+    if(Expander::isVirtual(device.iopin)){
+      Serial.println("Error. Counters need an interrupt capable pin.");
+      continue;
+    }
+    if(slot >= MAX_COUNTERS){
+      Serial.println("Error. Too many counters.");
+      break;
+    }
+
+    // Restore the count from before a soft reset if it is for the same device.
+    uint32_t count = 0;
+    if(rtc_state.counter_device[slot] == i &&
+        rtc_state.counter_pin[slot] == (uint32_t)device.iopin){
+      count = rtc_state.counter_count[slot];
+    }
+    pulse_count[slot] = count;
+    device.io_value = count;
+
+    counters[slot].device = i;
+    counters[slot].head = 0;
+    counters[slot].rate = 0;
+    for(uint8_t j = 0; j < COUNTER_WINDOW; j++){
+      counters[slot].window[j] = count;
+    }
+    rtc_state.counter_device[slot] = i;
+    rtc_state.counter_pin[slot] = device.iopin;
+    rtc_state.counter_count[slot] = count;
+
+    // Pulse outputs are usually open collector so count falling edges
+    // unless the device is inverted.
+    setPinMode(device.iopin, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(device.iopin), pulse_handlers[slot],
+                    device.inverted ? RISING : FALLING);
+    slot++;
+  }
+  for(; slot < MAX_COUNTERS; slot++){
+    counters[slot].device = -1;
+    rtc_state.counter_device[slot] = -1;
+  }
+  rtcSave();
+}
+
+// Called once per second.
+void Io::updateCounters(){
+  bool changed = false;
+  for(uint8_t slot = 0; slot < MAX_COUNTERS; slot++){
+    Pulse_Counter& pulse_counter = counters[slot];
+    if(pulse_counter.device < 0){
+      continue;
+    }
+    const uint32_t count = pulse_count[slot];
+
+    // window[head] is the oldest entry so is replaced by the newest.
+    pulse_counter.rate = (count - pulse_counter.window[pulse_counter.head]) * 60 / COUNTER_WINDOW;
+    pulse_counter.window[pulse_counter.head] = count;
+    pulse_counter.head = (pulse_counter.head +1) % COUNTER_WINDOW;
+
+    if(rtc_state.counter_count[slot] != count){
+      rtc_state.counter_count[slot] = count;
+      changed = true;
+    }
+
+    Connected_device& device = config.devices[pulse_counter.device];
+    const uint32_t interval = (device.io_interval > 0 ? device.io_interval : COUNTER_INTERVAL);
+    if(millis() - announced_at[pulse_counter.device] >= interval){
+      device.io_value = count;
+      device.dirty = true;
+    }
+  }
+  if(changed){
+    rtcSave();
+  }
+}
+
+uint32_t Io::counterRate(const Connected_device& device){
+  for(uint8_t slot = 0; slot < MAX_COUNTERS; slot++){
+    if(counters[slot].device >= 0 && &config.devices[counters[slot].device] == &device){
+      return counters[slot].rate;
+    }
+  }
+  return 0;
+}
+
+void Io::setupEncoders(){
+  uint8_t slot = 0;
+  for(int i=0; i < MAX_DEVICES; i++){
+    Connected_device& device = config.devices[i];
+    if(device.io_type != encoder || !config.deviceInUse(i)){
+      continue;
+    }
+    // GPIO16 has no interrupt.
+    if(device.iopin2 == IOPIN_NONE || device.iopin2 == device.iopin ||
+        device.iopin == 16 || device.iopin2 == 16 ||
+        Expander::isVirtual(device.iopin) || Expander::isVirtual(device.iopin2)){
+      Serial.println("Error. Encoders need interrupt capable pins.");
+      continue;
+    }
+    if(slot >= MAX_ENCODERS){
+      Serial.println("Error. Too many encoders.");
+      break;
+    }
+
+    setPinMode(device.iopin, INPUT_PULLUP);
+    setPinMode(device.iopin2, INPUT_PULLUP);
+    encoder_pins[slot][0] = device.iopin;
+    encoder_pins[slot][1] = device.iopin2;
+    encoder_state[slot] = (digitalRead(device.iopin) << 1) | digitalRead(device.iopin2);
+    encoder_position[slot] = 0;
+    encoders[slot].device = i;
+    encoders[slot].position = 0;
+    device.io_value = 0;
+
+    attachInterrupt(digitalPinToInterrupt(device.iopin), encoder_handlers[slot], CHANGE);
+    attachInterrupt(digitalPinToInterrupt(device.iopin2), encoder_handlers[slot], CHANGE);
+    slot++;
+  }
+  for(; slot < MAX_ENCODERS; slot++){
+    encoders[slot].device = -1;
+  }
+}
+
+// Called every loop. Rules follow every movement but the position is only
+// announced once per io_interval.
+void Io::updateEncoders(){
+  for(uint8_t slot = 0; slot < MAX_ENCODERS; slot++){
+    Encoder_State& encoder_ = encoders[slot];
+    if(encoder_.device < 0){
+      continue;
+    }
+    Connected_device& device = config.devices[encoder_.device];
+    int32_t position = encoder_position[slot];
+    if(device.inverted){
+      position = -position;
+    }
+
+    if(position != encoder_.position){
+      const int change = position - encoder_.position;
+      encoder_.position = position;
+      applyRules(encoder_.device, change);
+    }
+
+    const uint32_t interval = (device.io_interval > 0 ? device.io_interval : ENCODER_INTERVAL);
+    if(position != device.io_value &&
+        millis() - announced_at[encoder_.device] >= interval){
+      device.io_value = position;
+      device.dirty = true;
+    }
+  }
+}
+
+// Steps of a sensor reading.
+enum Sensor_Step {
+  sensor_idle,
+  ds18b20_convert_reset,
+  ds18b20_convert_skip,
+  ds18b20_convert,
+  ds18b20_converting,
+  ds18b20_read_reset,
+  ds18b20_read_skip,
+  ds18b20_read_command,
+  ds18b20_read_data,
+  dht22_start,
+  dht22_listen,
+  dht22_reading
+};
+
+void Io::setupSensors(){
+  uint8_t slot = 0;
+  for(int i=0; i < MAX_DEVICES; i++){
+    Connected_device& device = config.devices[i];
+    if((device.io_type != ds18b20 && device.io_type != dht22) || !config.deviceInUse(i)){
+      continue;
+    }
+    if(Expander::isVirtual(device.iopin)){
+      Serial.println("Error. Sensors need a GPIO pin.");
+      continue;
+    }
+    if(slot >= MAX_SENSORS){
+      Serial.println("Error. Too many sensors.");
+      break;
+    }
+    Sensor_State& sensor = sensors[slot++];
+    memset(&sensor, 0, sizeof(sensor));
+    sensor.device = i;
+    sensor.step = sensor_idle;
+    sensor.step_at = millis();
+    device.io_value = 0;
+  }
+  for(; slot < MAX_SENSORS; slot++){
+    sensors[slot].device = -1;
+  }
+  sensor_next = 0;
+  dht_busy = false;
+}
+
+// Run one step of one sensor's reading. Sensors take turns so each
+// Io::loop() does no more than one short bus operation.
+void Io::stepSensors(){
+  for(uint8_t tries = 0; tries < MAX_SENSORS; tries++){
+    Sensor_State& sensor = sensors[sensor_next];
+    sensor_next = (sensor_next +1) % MAX_SENSORS;
+    if(sensor.device < 0 || (long)(millis() - sensor.step_at) < 0){
+      continue;
+    }
+
+    const unsigned long started = micros();
+    stepSensor(sensor);
+    const uint32_t taken = micros() - started;
+    if(taken > sensor_step_max_us){
+      sensor_step_max_us = taken;
+    }
+    if(taken > SENSOR_STEP_BUDGET_US){
+      sensor_overruns++;
+    }
+    return;
+  }
+}
+
+void Io::stepSensor(Sensor_State& sensor){
+  const Connected_device& device = config.devices[sensor.device];
+  const uint8_t pin = device.iopin;
+
+  switch(sensor.step){
+    case sensor_idle:
+      sensor.step = (device.io_type == dht22 ? dht22_start : ds18b20_convert_reset);
+      break;
+
+    // DS18B20. Only one sensor per pin so there is no need to address it.
+    case ds18b20_convert_reset:
+    case ds18b20_read_reset:
+      if(!sensor_bus->oneWireReset(pin)){
+        sensorFailed(sensor);
+        break;
+      }
+      sensor.step++;
+      break;
+    case ds18b20_convert_skip:
+    case ds18b20_read_skip:
+      sensor_bus->oneWireWrite(pin, DS18B20_SKIP_ROM);
+      sensor.step++;
+      break;
+    case ds18b20_convert:
+      sensor_bus->oneWireWrite(pin, DS18B20_CONVERT);
+      sensor.step = ds18b20_converting;
+      sensor.step_at = millis() + DS18B20_CONVERSION_MS;
+      break;
+    case ds18b20_converting:
+      sensor.step = ds18b20_read_reset;
+      break;
+    case ds18b20_read_command:
+      sensor_bus->oneWireWrite(pin, DS18B20_READ_SCRATCHPAD);
+      sensor.index = 0;
+      sensor.step = ds18b20_read_data;
+      break;
+    case ds18b20_read_data:
+      sensor.data[sensor.index++] = sensor_bus->oneWireRead(pin);
+      if(sensor.index < 9){
+        break;
+      }
+      if(oneWireCrc8(sensor.data, 8) != sensor.data[8]){
+        sensorFailed(sensor);
+        break;
+      }
+      // 1/16ths of a degree to tenths.
+      sensorReading(sensor, (int16_t)(sensor.data[1] << 8 | sensor.data[0]) * 10 / 16, 0);
+      break;
+
+    // DHT22.
+    case dht22_start:
+      if(dht_busy){
+        sensor.step_at = millis() + DHT22_TIMEOUT;
+        break;
+      }
+      dht_busy = true;
+      sensor_bus->dhtStart(pin);
+      sensor.step = dht22_listen;
+      // Start signal must be held for at least 1ms.
+      sensor.step_at = millis() + 2;
+      break;
+    case dht22_listen:
+      sensor_bus->dhtListen(pin);
+      sensor.step = dht22_reading;
+      sensor.timeout_at = millis() + DHT22_TIMEOUT;
+      break;
+    case dht22_reading:
+      if(sensor_bus->dhtRead(pin, sensor.data)){
+        dht_busy = false;
+        if(((sensor.data[0] + sensor.data[1] + sensor.data[2] + sensor.data[3]) & 0xFF) !=
+            sensor.data[4]){
+          sensorFailed(sensor);
+          break;
+        }
+        int temperature = (sensor.data[2] & 0x7F) << 8 | sensor.data[3];
+        if(sensor.data[2] & 0x80){
+          temperature = -temperature;
+        }
+        sensorReading(sensor, temperature, sensor.data[0] << 8 | sensor.data[1]);
+      } else if((long)(millis() - sensor.timeout_at) >= 0){
+        dht_busy = false;
+        sensorFailed(sensor);
+      }
+      break;
+  }
+}
+
+static unsigned long sensorInterval(const Connected_device& device){
+  unsigned long interval = device.io_sample_interval;
+  if(interval == 0){
+    interval = SENSOR_SAMPLE_INTERVAL;
+  }
+  if(device.io_type == dht22 && interval < DHT22_MIN_INTERVAL){
+    interval = DHT22_MIN_INTERVAL;
+  }
+  return interval;
+}
+
+// A reading has completed. Temperatures are in tenths of a degree C.
+void Io::sensorReading(Sensor_State& sensor, const int reading, const int humidity){
+  Connected_device& device = config.devices[sensor.device];
+  sensor.step = sensor_idle;
+  sensor.step_at = millis() + sensorInterval(device);
+  sensor.errors = 0;
+  sensor.humidity = humidity;
+
+  const bool changed = (abs(reading - device.io_value) >= device.io_deadband &&
+                        reading != device.io_value) ||
+                       (abs(humidity - sensor.humidity_announced) >= device.io_deadband &&
+                        humidity != sensor.humidity_announced);
+  const bool expired = (device.io_interval > 0 &&
+                        millis() - announced_at[sensor.device] >= device.io_interval);
+  if(changed || expired){
+    device.io_value = reading;
+    sensor.humidity_announced = humidity;
+    device.dirty = true;
+  }
+}
+
+void Io::sensorFailed(Sensor_State& sensor){
+  Serial.print("Error reading sensor on pin: ");
+  Serial.println(config.devices[sensor.device].iopin);
+  sensor.step = sensor_idle;
+  sensor.step_at = millis() + sensorInterval(config.devices[sensor.device]);
+  if(sensor.errors < 255){
+    sensor.errors++;
+  }
+}
+
+Sensor_State* Io::sensorFor(const Connected_device& device){
+  for(uint8_t slot = 0; slot < MAX_SENSORS; slot++){
+    if(sensors[slot].device >= 0 && &config.devices[sensors[slot].device] == &device){
+      return &sensors[slot];
+    }
+  }
+  return nullptr;
+}
 
 void Io::setup(){
+  memset(pulse_until, 0, sizeof(pulse_until));
+  if(expander){
+    expander->begin();
+  }
+  const bool rtc_valid = rtcLoad();
+  setupCounters();
+  setupSensors();
+  setupEncoders();
+  memset(&sampler, 0, sizeof(sampler));
+  announce_held = 0;
   for(int i=0; i < MAX_DEVICES; i++){
-    if (strlen(config.devices[i].address_segment[0].segment) > 0) {
-      if(config.devices[i].io_type == inputpullup){
+    announced_at[i] = 0;
+    suppressed[i] = 0;
+    if (config.deviceInUse(i)) {
+      if(config.devices[i].io_type == analog){
+        // Sample as fast as the fastest analog device needs.
+        config.devices[i].io_value = 0;
+        uint32_t sample_interval = config.devices[i].io_sample_interval;
+        if(sample_interval == 0){
+          sample_interval = ANALOG_SAMPLE_INTERVAL;
+        }
+        if(sampler.sample_interval == 0 || sample_interval < sampler.sample_interval){
+          sampler.sample_interval = sample_interval;
+        }
+      } else if(config.devices[i].io_type == counter){
+        // Already configured by setupCounters().
+      } else if(config.devices[i].io_type == ds18b20 ||
+                config.devices[i].io_type == dht22){
+        // Already configured by setupSensors().
+      } else if(config.devices[i].io_type == encoder){
+        // Already configured by setupEncoders().
+      } else if(config.devices[i].io_type == inputpullup){
         config.devices[i].io_value = 1;
         setPinMode(config.devices[i].iopin, INPUT_PULLUP);
-        if(callback){
+        // Expander inputs are polled when the expander signals a change.
+        if(callback && !Expander::isVirtual(config.devices[i].iopin)){
           attachInterrupt(digitalPinToInterrupt(config.devices[i].iopin),
                           callback, CHANGE);
         }
       } else if(config.devices[i].io_type == input){
         config.devices[i].io_value = 1;
         setPinMode(config.devices[i].iopin, INPUT);
-        if(callback){
+        // Expander inputs are polled when the expander signals a change.
+        if(callback && !Expander::isVirtual(config.devices[i].iopin)){
           attachInterrupt(digitalPinToInterrupt(config.devices[i].iopin),
                           callback, CHANGE);
         }
@@ -173,32 +764,48 @@ void Io::setup(){
         if (config.devices[i].io_default > 255 || config.devices[i].io_default < 0) {
           config.devices[i].io_default = 0;
         }
-        config.devices[i].io_value = config.devices[i].io_default;
+        if(rtc_valid &&
+            rtc_state.output_type[i] == config.devices[i].io_type &&
+            rtc_state.output_pin[i] == config.devices[i].iopin)
+        {
+          // Soft reset. Carry on where we left off rather than waiting for
+          // a controller to re-send the state.
+          config.devices[i].io_value = rtc_state.output_value[i];
+        } else {
+          config.devices[i].io_value = config.devices[i].io_default;
+        }
         setState(config.devices[i]);
       }
     }
   }
   dirty_inputs = true;
+  renderAnnounce();
   loop();
 }
 
 void Io::loop(){
   const unsigned int now = millis() / 1000;
 
+  if(expander && expander->poll()){
+    dirty_inputs = true;
+  }
+
   if(dirty_inputs){
     dirty_inputs = false;
     for(int i=0; i < MAX_DEVICES; i++){
-      if (strlen(config.devices[i].address_segment[0].segment) > 0) {
+      if (config.deviceInUse(i)) {
         if(config.devices[i].io_type == input || config.devices[i].io_type == inputpullup){
-          byte value = digitalRead(config.devices[i].iopin);
+          byte value = pinRead(config.devices[i].iopin);
           value = (config.devices[i].inverted ? value == 0 : value);
           if(value != config.devices[i].io_value){
+            const int change = value - config.devices[i].io_value;
             config.devices[i].io_value = value;
             //String topic;
             //String payload;
             //toAnnounce(config.devices[i], topic, payload);
             //mqtt->publish(topic, payload);
             config.devices[i].dirty = true;
+            applyRules(i, change);
 
             // This pin is also the enable pin for the configuration menu.
             if(i == config.enableiopin){
@@ -209,20 +816,172 @@ void Io::loop(){
       }
     }
   }
+  if(sampler.sample_interval > 0 && millis() - sampler.sampled_at >= sampler.sample_interval){
+    sampler.sampled_at = millis();
+    sampleAnalog();
+  }
+  restorePulses();
+  stepSensors();
+  updateEncoders();
   if(last_update != now){
     last_update = now;
+    updateCounters();
     for(int i=0; i < MAX_DEVICES; i++){
       if(config.devices[i].io_type == timer){
         setState(config.devices[i]);
       }
     }
   }
+
+  // All expander output changes from this pass (and from MQTT commands since
+  // the last pass) go out in one bus transaction.
+  if(expander){
+    expander->flush();
+  }
+
+  if(rtc_dirty){
+    rtc_dirty = false;
+    rtcSave();
+  }
+}
+
+// Moving average over the last ANALOG_RING_LEN samples of A0.
+// Devices are only re-evaluated once per full ring so the filtered value is
+// decimated rather than reconsidered on every sample.
+void Io::sampleAnalog(){
+  const uint16_t sample = analogRead(A0);
+  sampler.sum -= sampler.ring[sampler.head];
+  sampler.sum += sample;
+  sampler.ring[sampler.head] = sample;
+  sampler.head = (sampler.head +1) % ANALOG_RING_LEN;
+  if(sampler.head != 0){
+    return;
+  }
+
+  const int filtered = sampler.sum / ANALOG_RING_LEN;
+  for(int i=0; i < MAX_DEVICES; i++){
+    Connected_device& device = config.devices[i];
+    if(device.io_type != analog || !config.deviceInUse(i)){
+      continue;
+    }
+    const int value = (device.inverted ? 1023 - filtered : filtered);
+    const bool changed = (abs(value - device.io_value) >= device.io_deadband &&
+                          value != device.io_value);
+    const bool expired = (device.io_interval > 0 &&
+                          millis() - announced_at[i] >= device.io_interval);
+    if(changed || expired){
+      device.io_value = value;
+      device.dirty = true;
+    }
+  }
+}
+
+// Act on any rules triggered by a change to the input device at input_index.
+// change is the new value of the input less the old one.
+void Io::applyRules(const int input_index, const int change){
+  const int input_value = config.devices[input_index].io_value;
+  for(int i = 0; i < MAX_RULES; i++){
+    const Rule& rule = config.rules[i];
+    if(rule.action == action_none || rule.input != input_index){
+      continue;
+    }
+    if((rule.trigger == trigger_on && input_value == 0) ||
+        (rule.trigger == trigger_off && input_value != 0)){
+      continue;
+    }
+    const int output_index = rule.output;
+    if(output_index >= MAX_DEVICES || !config.deviceInUse(output_index)){
+      continue;
+    }
+
+    Connected_device& output = config.devices[output_index];
+    if(output.io_type != onoff && output.io_type != pwm && output.io_type != test){
+      // Inputs and sensors would only announce a state they do not have.
+      continue;
+    }
+    if(rule.action == action_toggle){
+      output.io_value = (output.io_value == 0 ? 255 : 0);
+    } else if(rule.action == action_set){
+      output.io_value = rule.value;
+    } else if(rule.action == action_pulse){
+      if(pulse_until[i] == 0){
+        pulse_restore[i] = output.io_value;
+      }
+      output.io_value = rule.value;
+      // 0 is reserved for "not pulsing".
+      pulse_until[i] = (millis() + rule.duration) | 1;
+    } else if(rule.action == action_follow){
+      output.io_value = constrain(output.io_value + change * (rule.value ? rule.value : 1),
+                                  0, 255);
+    }
+    setState(output);
+    if(rule.action == action_pulse){
+      // A reset part way through a pulse should not leave the output pulsed.
+      rtc_state.output_value[output_index] = pulse_restore[i];
+    }
+  }
+}
+
+// Return outputs to their previous value once an action_pulse has expired.
+void Io::restorePulses(){
+  for(int i = 0; i < MAX_RULES; i++){
+    if(pulse_until[i] != 0 && (long)(millis() - pulse_until[i]) >= 0){
+      pulse_until[i] = 0;
+      const int output_index = config.rules[i].output;
+      if(output_index < MAX_DEVICES && config.deviceInUse(output_index)){
+        config.devices[output_index].io_value = pulse_restore[i];
+        setState(config.devices[output_index]);
+      }
+    }
+  }
 }
 
-bool Io::getOutput(String& return_topic, String& return_payload){
+bool Io::getOutput(const char*& return_topic, const char*& return_payload){
+  if(group_pending != 0){
+    // A group goes out straight away but still counts against each device's
+    // rate limit.
+    group_payload = "{\"_devices\":[";
+    bool any = false;
+    for(int i=0; i < MAX_DEVICES; i++){
+      if(!(group_pending & (1UL << i)) || !config.deviceInUse(i)){
+        continue;
+      }
+      announce_held &= ~(1UL << i);
+      config.devices[i].dirty = false;
+      announced_at[i] = millis();
+      const char* payload;
+      toAnnounce(config.devices[i], return_topic, payload);
+      if(any){
+        group_payload += ",";
+      }
+      group_payload += payload;
+      any = true;
+    }
+    group_pending = 0;
+    group_payload += "]}";
+    if(any){
+      return_payload = group_payload.c_str();
+      return true;
+    }
+  }
+
   for(int i=0; i < MAX_DEVICES; i++){
     if(config.devices[i].dirty == true){
+      const uint32_t rate_limit = (config.devices[i].rate_limit > 0 ?
+                                   config.devices[i].rate_limit : ANNOUNCE_RATE_LIMIT);
+      if(millis() - announced_at[i] < rate_limit){
+        // Leave it dirty so the latest state goes out once the limit allows.
+        if(!(announce_held & (1UL << i))){
+          announce_held |= (1UL << i);
+        } else if(held_value[i] != config.devices[i].io_value){
+          suppressed[i]++;
+        }
+        held_value[i] = config.devices[i].io_value;
+        continue;
+      }
+      announce_held &= ~(1UL << i);
       config.devices[i].dirty = false;
+      announced_at[i] = millis();
       toAnnounce(config.devices[i], return_topic, return_payload);
       return true;
     }
@@ -230,20 +989,46 @@ bool Io::getOutput(String& return_topic, String& return_payload){
   return false;
 }
 
+uint32_t Io::announceSuppressedTotal(){
+  uint32_t total = 0;
+  for(int i=0; i < MAX_DEVICES; i++){
+    total += suppressed[i];
+  }
+  return total;
+}
+
+// Besides absolute values, commands may be relative to the current state so
+// controllers do not need to read the state first:
+//   "toggle"     Off if on, otherwise fully on.
+//   "+N" / "-N"  Step by N, limited to 0-255.
+//   "min"/"max"  0 or 255.
 void Io::changeState(Connected_device& device, String command){
   command.toLowerCase();
-  device.io_value = command.toInt();
-  if(command == "on" || command == "true"){
+  command.trim();
+  if(command == "on" || command == "true" || command == "max"){
     device.io_value = 255;
-  } else if(command == "off" || command == "false"){
-    device.io_value = 0;
-  } else if (device.io_value > 255 || device.io_value <= 0) {
+  } else if(command == "off" || command == "false" || command == "min"){
     device.io_value = 0;
+  } else if(command == "toggle"){
+    device.io_value = (device.io_value == 0 ? 255 : 0);
+  } else if(command.startsWith("+") || command.startsWith("-")){
+    device.io_value = constrain(device.io_value + command.toInt(), 0, 255);
+  } else {
+    device.io_value = command.toInt();
+    if (device.io_value > 255 || device.io_value <= 0) {
+      device.io_value = 0;
+    }
   }
   setState(device);
 }
 
 void Io::setPinMode(uint8_t iopin, uint8_t mode){
+  if(Expander::isVirtual(iopin)){
+    if(expander){
+      expander->pinMode(iopin, mode);
+    }
+    return;
+  }
   if(pin_modes[iopin] != mode){
     pin_modes[iopin] = mode;
     pinMode(iopin, mode);
@@ -251,12 +1036,35 @@ void Io::setPinMode(uint8_t iopin, uint8_t mode){
 }
 
 void Io::setPinAnalog(uint8_t iopin, int value){
+  if(Expander::isVirtual(iopin)){
+    // Expander pins are digital only.
+    pinWrite(iopin, value >= 128);
+    return;
+  }
   if(pin_analog_value[iopin] != value){
     pin_analog_value[iopin] = value;
     analogWrite(iopin, value);
   }
 }
 
+// Expander pins are only written to the bus at the end of Io::loop().
+void Io::pinWrite(uint8_t iopin, bool value){
+  if(Expander::isVirtual(iopin)){
+    if(expander){
+      expander->digitalWrite(iopin, value);
+    }
+    return;
+  }
+  digitalWrite(iopin, value);
+}
+
+bool Io::pinRead(uint8_t iopin){
+  if(Expander::isVirtual(iopin)){
+    return expander && expander->digitalRead(iopin);
+  }
+  return digitalRead(iopin);
+}
+
 void Io::setState(Connected_device& device){
   if(device.io_type == onoff){
     setPinMode(device.iopin, OUTPUT);
@@ -264,17 +1072,25 @@ void Io::setState(Connected_device& device){
     // before using digital output.
     setPinAnalog(device.iopin, 0);
     
-    digitalWrite(device.iopin, device.inverted ? (device.io_value == 0) : device.io_value);
+    pinWrite(device.iopin, device.inverted ? (device.io_value == 0) : device.io_value);
+    rtcRecord(device);
   } else if(device.io_type == pwm){
     setPinMode(device.iopin, OUTPUT);
     setPinAnalog(device.iopin, device.inverted ? (255 - device.io_value) : device.io_value);
+    rtcRecord(device);
   } else if(device.io_type == test){
     Serial.print("Switching pin: ");
     Serial.print(device.iopin);
     Serial.print(" to value: ");
     Serial.println(device.inverted ? (255 - device.io_value) : device.io_value);
+    rtcRecord(device);
   } else if(device.io_type == input){
   } else if(device.io_type == inputpullup){
+  } else if(device.io_type == analog){
+  } else if(device.io_type == counter){
+  } else if(device.io_type == ds18b20){
+  } else if(device.io_type == dht22){
+  } else if(device.io_type == encoder){
   } else if(device.io_type == timer){
     const int now = millis() / 1000;
     setPinMode(device.iopin, OUTPUT);
@@ -285,8 +1101,8 @@ void Io::setState(Connected_device& device){
     if(device.io_value != ((now % device.io_default) != (device.io_default -1))){
       device.io_value = ((now % device.io_default) != (device.io_default -1));
 
-      digitalWrite(device.iopin, device.inverted ? (device.io_value == 0) : 
-                                                     device.io_value);
+      pinWrite(device.iopin, device.inverted ? (device.io_value == 0) :
+                                                 device.io_value);
     } else {
       // Only continue to MQTT announcements when state changes.
       return;
@@ -303,16 +1119,139 @@ void Io::inputCallback(){
 void Io::toAnnounce(const Connected_device& device,
                       String& topic, String& payload)
 {
-  topic = config.publishprefix;
-  topic += "/io/_announce";
-  
-  payload = "{\"_state\":\"";
-  payload += String(device.io_value);
-  payload += "\",\"_iopin\":\"";
-  payload += String(device.iopin);
-  payload += "\",\"_subject\":\"";
-  payload += DeviceAddress(device);
-  payload += "\"}";
+  const char* topic_;
+  const char* payload_;
+  toAnnounce(device, topic_, payload_);
+  topic = topic_;
+  payload = payload_;
+}
+
+// Write a number into a fixed width slot of a pre-rendered announcement.
+// Trailing whitespace pads the slot so the JSON stays valid.
+static void patchSlot(char* slot, const uint8_t slot_len, const int value){
+  char digits[12];
+  const uint8_t digits_len = snprintf(digits, sizeof(digits), "%d", value);
+  slot[0] = '"';
+  memcpy(slot +1, digits, digits_len);
+  slot[digits_len +1] = '"';
+  memset(slot + digits_len +2, ' ', slot_len - digits_len -2);
+}
+
+#define ANNOUNCE_STATE_OFFSET 10  // strlen("{\"_state\":")
+#define ANNOUNCE_PIN_OFFSET (ANNOUNCE_STATE_OFFSET + ANNOUNCE_STATE_LEN + 10)
+
+// Name of the second value some device types announce, or nullptr.
+static const char* announceExtraKey(const uint8_t io_type){
+  if(io_type == counter){
+    return "_rate";
+  } else if(io_type == dht22){
+    return "_humidity";
+  }
+  return nullptr;
+}
+
+// strlen(",\"<key>\":")
+#define ANNOUNCE_EXTRA_OFFSET(key) (ANNOUNCE_PIN_OFFSET + ANNOUNCE_PIN_LEN + strlen(key) + 4)
+
+int Io::announceExtra(const Connected_device& device){
+  if(device.io_type == counter){
+    return counterRate(device);
+  } else if(device.io_type == dht22){
+    const Sensor_State* sensor = sensorFor(device);
+    return (sensor ? sensor->humidity_announced : 0);
+  }
+  return 0;
+}
+
+// Render the parts of a device's "_announce" payload that only change with config.
+// Returns the payload length or 0 if it did not fit in dest.
+uint16_t Io::renderTemplate(const Connected_device& device, char* dest,
+                            const uint16_t dest_len)
+{
+  int len;
+  const char* extra_key = announceExtraKey(device.io_type);
+  if(extra_key){
+    len = snprintf(dest, dest_len,
+                   "{\"_state\":%*s,\"_iopin\":%*s,\"%s\":%*s,\"_subject\":\"%s\"}",
+                   ANNOUNCE_STATE_LEN, "", ANNOUNCE_PIN_LEN, "", extra_key, ANNOUNCE_STATE_LEN, "",
+                   DeviceAddress(device).c_str());
+  } else {
+    len = snprintf(dest, dest_len, "{\"_state\":%*s,\"_iopin\":%*s,\"_subject\":\"%s\"}",
+                   ANNOUNCE_STATE_LEN, "", ANNOUNCE_PIN_LEN, "",
+                   DeviceAddress(device).c_str());
+  }
+  if(len <= 0 || len >= dest_len){
+    return 0;
+  }
+  patchSlot(dest + ANNOUNCE_PIN_OFFSET, ANNOUNCE_PIN_LEN, device.iopin);
+  return len;
+}
+
+void Io::renderAnnounce(){
+  announce_stale = false;
+  snprintf(announce_topic, sizeof(announce_topic), "%s/io/_announce", config.publishprefix);
+
+  uint16_t used = 0;
+  for(int i=0; i < MAX_DEVICES; i++){
+    announce[i].len = 0;
+    if (config.deviceInUse(i)) {
+      const uint16_t len = renderTemplate(config.devices[i], announce_buffer + used,
+                                          ANNOUNCE_BUFFER_LEN - used);
+      if(len > 0){
+        announce[i].start = used;
+        announce[i].len = len;
+        used += len +1;
+      }
+    }
+  }
+}
+
+void Io::toAnnounce(const Connected_device& device,
+                      const char*& topic, const char*& payload)
+{
+  if(announce_stale){
+    renderAnnounce();
+  }
+
+  char* dest = announce_scratch;
+  const bool configured = (&device >= config.devices && &device < config.devices + MAX_DEVICES);
+  if(configured && announce[&device - config.devices].len > 0){
+    dest = announce_buffer + announce[&device - config.devices].start;
+  } else {
+    // Not one of config.devices or did not fit in announce_buffer.
+    renderTemplate(device, announce_scratch, ANNOUNCE_PAYLOAD_LEN);
+  }
+  patchSlot(dest + ANNOUNCE_STATE_OFFSET, ANNOUNCE_STATE_LEN, device.io_value);
+  const char* extra_key = announceExtraKey(device.io_type);
+  if(extra_key){
+    patchSlot(dest + ANNOUNCE_EXTRA_OFFSET(extra_key), ANNOUNCE_STATE_LEN,
+              announceExtra(device));
+  }
+
+  topic = announce_topic;
+  payload = dest;
+}
+
+const String TriggerToString(uint8_t trigger){
+  if (trigger == trigger_on) {
+    return "on";
+  } else if (trigger == trigger_off) {
+    return "off";
+  }
+  return "change";
+}
+
+const String ActionToString(uint8_t action){
+  if (action == action_toggle) {
+    return "toggle";
+  } else if (action == action_set) {
+    return "set";
+  } else if (action == action_pulse) {
+    return "pulse";
+  } else if (action == action_follow) {
+    return "follow";
+  }
+  return "none";
 }
 
 const String TypeToString(Io_Type type){
@@ -326,6 +1265,16 @@ const String TypeToString(Io_Type type){
     return "inputpullup";
   } else if (type == Io_Type::timer) {
     return "timer";
+  } else if (type == Io_Type::analog) {
+    return "analog";
+  } else if (type == Io_Type::counter) {
+    return "counter";
+  } else if (type == Io_Type::ds18b20) {
+    return "ds18b20";
+  } else if (type == Io_Type::dht22) {
+    return "dht22";
+  } else if (type == Io_Type::encoder) {
+    return "encoder";
   }
   return "test";
 }
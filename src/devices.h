@@ -25,34 +25,157 @@
 #include <Arduino.h>  // String
 #include <ESP8266WiFi.h>
 #include "config.h"
+#include "expander.h"
+#include "sensors.h"
 
 
 struct Address_Segment {
   char segment[NAME_LEN];
 };
 
-enum Io_Type {
+enum Io_Type : uint8_t {
   test,
   onoff,
   pwm,
   inputpullup,
   input,
-  timer
+  timer,
+  analog,
+  counter,
+  ds18b20,
+  dht22,
+  encoder
 };
 
+const uint8_t IO_TYPE_COUNT = 11;
+
+// Address segments of all devices, stored once each.
+// Offset 0 is always the empty string so a zeroed device has an empty address.
+struct Segment_Pool {
+  char pool[SEGMENT_POOL_LEN];
+  uint16_t used;
+
+  const char* segment(const uint16_t offset) const { return pool + offset; }
+  // Return the offset of segment, adding it to the pool if not already present.
+  // Returns 0 if the pool is full.
+  uint16_t intern(const char* segment_);
+  // Drop segments no longer referenced by any configured device.
+  void compact();
+};
+
+#define IOPIN_NONE 0xFF  // Pin not configured.
+
 struct Connected_device {
-  Address_Segment address_segment[ADDRESS_SEGMENTS];
+  uint16_t address[ADDRESS_SEGMENTS];  // Offsets into Config::segments.
   Io_Type io_type;
-  int iopin;
-  int io_value;
-  int io_default;
+  uint8_t iopin;
   bool inverted;
   bool dirty;          // Data has changed since last announced IO pin.
+  int io_value;
+  int16_t io_default;
+  uint16_t io_deadband;         // Minimum change in a filtered input before it is announced.
+  uint32_t io_sample_interval;  // Milliseconds between samples of an analog input.
+  uint32_t io_interval;         // Maximum milliseconds between announcements. 0 to disable.
+  uint8_t iopin2;               // Second pin of an encoder. IOPIN_NONE if not configured.
+  uint16_t rate_limit;          // Minimum milliseconds between announcements. 0 for the default.
 
   void setType(const String& type);
   void setInverted(const String& value);
 };
 
+#define RULE_NO_DEVICE 0xFF
+
+enum Rule_Trigger {
+  trigger_change,
+  trigger_on,
+  trigger_off
+};
+
+enum Rule_Action {
+  action_none,
+  action_toggle,
+  action_set,
+  action_pulse,
+  action_follow
+};
+
+// Act on an output device when an input device changes, without waiting for
+// a controller to do it over MQTT.
+// Devices are referred to by their index in config.devices, which unlike the
+// label used by the "io" tags does not change as other devices come and go.
+// The "rules" tags convert to and from labels.
+struct Rule {
+  uint8_t input;       // Index into config.devices or RULE_NO_DEVICE.
+  uint8_t output;      // Index into config.devices or RULE_NO_DEVICE.
+  uint8_t trigger;     // Rule_Trigger
+  uint8_t action;      // Rule_Action. action_none marks an unused rule.
+  int16_t value;       // Output value for action_set and action_pulse.
+                       // Output change per input step for action_follow.
+  uint16_t duration;   // Milliseconds before action_pulse restores the output.
+
+  void setTrigger(const String& trigger_);
+  void setAction(const String& action_);
+};
+
+// Samples of the ESP8266's single analog input (A0).
+// Shared by all devices of Io_Type::analog.
+struct Analog_Sampler {
+  uint16_t ring[ANALOG_RING_LEN];
+  uint8_t head;
+  uint32_t sum;
+  uint32_t sample_interval;  // 0 if no analog devices are configured.
+  unsigned long sampled_at;
+};
+
+// Runtime state of a device of Io_Type::counter.
+// The count itself is incremented from an interrupt so lives elsewhere.
+struct Pulse_Counter {
+  int8_t device;                    // Index into config.devices or -1 if unused.
+  uint32_t window[COUNTER_WINDOW];  // Count at each of the last COUNTER_WINDOW seconds.
+  uint8_t head;
+  uint32_t rate;                    // Pulses per minute over the window.
+};
+
+// Runtime state of a device of Io_Type::ds18b20 or Io_Type::dht22.
+// A reading is split into short steps, one per Io::loop(), so waiting for a
+// conversion never blocks.
+struct Sensor_State {
+  int8_t device;              // Index into config.devices or -1 if unused.
+  uint8_t step;               // Sensor_Step.
+  uint8_t index;              // Next byte of data to read.
+  uint8_t errors;             // Consecutive failed readings.
+  uint8_t data[9];
+  unsigned long step_at;      // millis() after which the next step may run.
+  unsigned long timeout_at;   // millis() after which a DHT22 reply is abandoned.
+  int16_t humidity;           // Last good reading in tenths of a percent. dht22 only.
+  int16_t humidity_announced;
+};
+
+// Runtime state of a device of Io_Type::encoder.
+// The position itself is updated from an interrupt so lives elsewhere.
+struct Encoder_State {
+  int8_t device;      // Index into config.devices or -1 if unused.
+  int32_t position;   // Position when last acted on by rules.
+};
+
+// Survives a soft reset in RTC user memory.
+struct Rtc_State {
+  uint32_t crc;
+  int32_t counter_device[MAX_COUNTERS];  // Index into config.devices for each count.
+  uint32_t counter_pin[MAX_COUNTERS];
+  uint32_t counter_count[MAX_COUNTERS];
+  // Last value of each output device, restored only if the type and pin still match.
+  uint8_t output_type[MAX_DEVICES];
+  uint8_t output_pin[MAX_DEVICES];
+  int16_t output_value[MAX_DEVICES];
+};
+
+// Where a device's pre-rendered "_announce" payload lives in Io::announce_buffer.
+struct Announce_Template {
+  uint16_t start;
+  uint8_t len;         // 0 if the payload did not fit in the buffer.
+};
+
 
 // Ensure buffer contains only valid characters for a word in an MQTT topic.
 void sanitizeTopicSection(char* buffer);
@@ -62,8 +185,10 @@ void sanitizeTopic(char* buffer);
 
 // Return MQTT address of a device.
 String DeviceAddress(const Connected_device& device);
-// Set MQTT address of a device.
-void DeviceAddressSet(Connected_device& device, const String& address);
+// Return one segment of a device's MQTT address. Empty if the address is shorter.
+const char* DeviceSegment(const Connected_device& device, const uint8_t segment);
+// Set MQTT address of a device. An empty address removes the device.
+void DeviceAddressSet(const unsigned int index, const String& address);
 
 // The part of the MQTT topic that is common to all messages on this device.
 void SetPrefix(const char* new_prefix, char* dest_buffer);
@@ -77,25 +202,96 @@ class Io{
   Io(){
     // Set these to an unlikely value so pins get initialised first time Io::setup() is called.
     memset(pin_modes, 255, 16);
+    announce_stale = true;
+    expander = nullptr;
+    rtc_dirty = false;
+    sensor_bus = &hardware_sensor_bus;
+    sensor_step_max_us = 0;
+    sensor_overruns = 0;
+    group_pending = 0;
   };
   void setup();
   void loop();
   void changeState(Connected_device& device, String command);
   void setState(Connected_device& device);
   void registerCallback(void(*callback_)()){ callback = callback_; }
+  // Pins EXPANDER_PIN_BASE and up are routed to expander_. Call before setup().
+  void registerExpander(Expander* expander_){ expander = expander_; }
   void inputCallback();
   void toAnnounce(const Connected_device& device, String& topic, String& payload);
-  bool getOutput(String& return_topic, String& return_payload);
+  void toAnnounce(const Connected_device& device, const char*& topic, const char*& payload);
+  bool getOutput(const char*& return_topic, const char*& return_payload);
+  // Announce these devices (bitmap of config.devices) together in one
+  // {"_devices":[...]} message from the next getOutput().
+  void announceGroup(const uint32_t devices){ group_pending |= devices; }
+
+  // Call whenever config that appears in "_announce" messages changes.
+  void invalidateAnnounce(){ announce_stale = true; }
+
+  // States of the device at index that were replaced before the rate limit
+  // allowed them to be announced.
+  uint32_t announceSuppressed(const int index){ return suppressed[index]; }
+  uint32_t announceSuppressedTotal();
+
+  uint32_t sensor_step_max_us;  // Longest single step of a sensor reading.
+  uint32_t sensor_overruns;     // Steps longer than SENSOR_STEP_BUDGET_US.
  private:
   void (*callback)();
+  Expander* expander;
+  SensorBus* sensor_bus;
+  void renderAnnounce();
+  uint16_t renderTemplate(const Connected_device& device, char* dest, const uint16_t dest_len);
   void setPinMode(uint8_t iopin, uint8_t mode);
   void setPinAnalog(uint8_t iopin, int value);
+  void pinWrite(uint8_t iopin, bool value);
+  bool pinRead(uint8_t iopin);
+  void sampleAnalog();
+  void setupCounters();
+  void updateCounters();
+  uint32_t counterRate(const Connected_device& device);
+  void setupSensors();
+  void stepSensors();
+  void stepSensor(Sensor_State& sensor);
+  void sensorReading(Sensor_State& sensor, const int reading, const int humidity);
+  void sensorFailed(Sensor_State& sensor);
+  Sensor_State* sensorFor(const Connected_device& device);
+  void setupEncoders();
+  void updateEncoders();
+  int announceExtra(const Connected_device& device);
+  bool rtcLoad();
+  void rtcSave();
+  void rtcRecord(const Connected_device& device);
+  void applyRules(const int input_index, const int change);
+  void restorePulses();
   bool dirty_inputs;
   unsigned int last_update;
   uint8_t pin_modes[16];
   int pin_analog_value[16];
+  Analog_Sampler sampler;
+  unsigned long announced_at[MAX_DEVICES];
+  uint32_t announce_held;                // Bitmap of devices waiting on their rate limit.
+  int held_value[MAX_DEVICES];           // Value of a held device when last checked.
+  uint32_t suppressed[MAX_DEVICES];
+  Pulse_Counter counters[MAX_COUNTERS];
+  Sensor_State sensors[MAX_SENSORS];
+  Encoder_State encoders[MAX_ENCODERS];
+  uint8_t sensor_next;                   // Sensors take turns to step.
+  bool dht_busy;                         // Only one DHT22 reply can be captured at a time.
+  Rtc_State rtc_state;
+  bool rtc_dirty;                        // rtc_state needs writing to RTC memory.
+  unsigned long pulse_until[MAX_RULES];  // 0 if the rule's output is not pulsed.
+  int pulse_restore[MAX_RULES];
+  bool announce_stale;
+  uint32_t group_pending;                // Bitmap of devices for announceGroup().
+  String group_payload;
+  char announce_topic[PREFIX_LEN + 16];
+  Announce_Template announce[MAX_DEVICES];
+  char announce_buffer[ANNOUNCE_BUFFER_LEN];
+  char announce_scratch[ANNOUNCE_PAYLOAD_LEN];
 };
 
 const String TypeToString(Io_Type type);
+const String TriggerToString(uint8_t trigger);
+const String ActionToString(uint8_t action);
 
 #endif  // ESP8266__DEVICES_H
@@ -0,0 +1,167 @@
+/* Copyright 2017 Duncan Law (mrdunk@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <Wire.h>
+#include "expander.h"
+
+// MCP23017 registers with IOCON.BANK = 0, so each A register is followed by its B register.
+#define MCP23017_IODIRA 0x00
+#define MCP23017_GPINTENA 0x04
+#define MCP23017_IOCON 0x0A
+#define MCP23017_GPPUA 0x0C
+#define MCP23017_GPIOA 0x12
+#define MCP23017_OLATA 0x14
+
+#define MCP23017_IOCON_MIRROR 0x40
+
+static volatile bool mcp23017_interrupt = true;
+
+static void ICACHE_RAM_ATTR onMcp23017Interrupt(){
+  mcp23017_interrupt = true;
+}
+
+void Mcp23017Bus::begin(){
+  Wire.begin(EXPANDER_SDA_PIN, EXPANDER_SCL_PIN);
+  Wire.beginTransmission(address);
+  Wire.write(MCP23017_IOCON);
+  Wire.write(MCP23017_IOCON_MIRROR);
+  Wire.endTransmission();
+
+  pinMode(int_pin, INPUT_PULLUP);
+  attachInterrupt(digitalPinToInterrupt(int_pin), onMcp23017Interrupt, FALLING);
+  mcp23017_interrupt = true;
+}
+
+void Mcp23017Bus::writeRegisters(const uint8_t reg, const uint16_t value){
+  Wire.beginTransmission(address);
+  Wire.write(reg);
+  Wire.write(value & 0xFF);
+  Wire.write(value >> 8);
+  Wire.endTransmission();
+}
+
+void Mcp23017Bus::setDirection(const uint16_t inputs, const uint16_t pullups){
+  writeRegisters(MCP23017_IODIRA, inputs);
+  writeRegisters(MCP23017_GPPUA, pullups);
+  // Interrupt on any change of an input pin.
+  writeRegisters(MCP23017_GPINTENA, inputs);
+}
+
+void Mcp23017Bus::writeOutputs(const uint16_t outputs){
+  writeRegisters(MCP23017_OLATA, outputs);
+}
+
+uint16_t Mcp23017Bus::readInputs(){
+  // Clear the flag first so a change during the read is not lost.
+  // Reading GPIO also clears the chip's interrupt.
+  mcp23017_interrupt = false;
+  Wire.beginTransmission(address);
+  Wire.write(MCP23017_GPIOA);
+  Wire.endTransmission(false);
+  Wire.requestFrom(address, (uint8_t)2);
+  uint16_t value = Wire.read();
+  value |= Wire.read() << 8;
+  return value;
+}
+
+bool Mcp23017Bus::inputsPending(){
+  // INTA stays low if a change was missed while the interrupt was being serviced.
+  return mcp23017_interrupt || digitalRead(int_pin) == LOW;
+}
+
+void ShiftRegisterBus::begin(){
+  pinMode(data_pin, OUTPUT);
+  pinMode(clock_pin, OUTPUT);
+  pinMode(latch_pin, OUTPUT);
+}
+
+void ShiftRegisterBus::writeOutputs(const uint16_t outputs){
+  digitalWrite(latch_pin, LOW);
+  shiftOut(data_pin, clock_pin, MSBFIRST, outputs >> 8);
+  shiftOut(data_pin, clock_pin, MSBFIRST, outputs & 0xFF);
+  digitalWrite(latch_pin, HIGH);
+}
+
+
+void Expander::begin(){
+  bus->begin();
+  dirty_direction = true;
+  // Force the first flush() to write every output.
+  written = ~outputs;
+  dirty_outputs = true;
+}
+
+void Expander::pinMode(const uint8_t pin, const uint8_t mode){
+  const uint8_t bit = pin - EXPANDER_PIN_BASE;
+  if(bit >= EXPANDER_PINS){
+    return;
+  }
+  const uint16_t mask = 1 << bit;
+  const uint16_t inputs_ = (mode == OUTPUT ? inputs & ~mask : inputs | mask);
+  const uint16_t pullups_ = (mode == INPUT_PULLUP ? pullups | mask : pullups & ~mask);
+  if(inputs_ != inputs || pullups_ != pullups){
+    inputs = inputs_;
+    pullups = pullups_;
+    dirty_direction = true;
+  }
+}
+
+void Expander::digitalWrite(const uint8_t pin, const bool value){
+  const uint8_t bit = pin - EXPANDER_PIN_BASE;
+  if(bit >= EXPANDER_PINS){
+    return;
+  }
+  if(value){
+    outputs |= (1 << bit);
+  } else {
+    outputs &= ~(1 << bit);
+  }
+  dirty_outputs = (outputs != written);
+}
+
+bool Expander::digitalRead(const uint8_t pin) const {
+  const uint8_t bit = pin - EXPANDER_PIN_BASE;
+  if(bit >= EXPANDER_PINS){
+    return false;
+  }
+  return input_state & (1 << bit);
+}
+
+bool Expander::poll(){
+  if(inputs == 0 || !bus->inputsPending()){
+    return false;
+  }
+  const uint16_t previous = input_state;
+  input_state = bus->readInputs() & inputs;
+  return input_state != previous;
+}
+
+void Expander::flush(){
+  if(dirty_direction){
+    dirty_direction = false;
+    bus->setDirection(inputs, pullups);
+  }
+  if(dirty_outputs){
+    dirty_outputs = false;
+    written = outputs;
+    bus->writeOutputs(outputs);
+  }
+}
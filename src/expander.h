@@ -0,0 +1,103 @@
+/* Copyright 2017 Duncan Law (mrdunk@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ESP8266__EXPANDER_H
+#define ESP8266__EXPANDER_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// Raw access to the pins of an IO expander chip.
+// Each call is one bus transaction covering every pin on the chip.
+class ExpanderBus {
+ public:
+  virtual ~ExpanderBus(){}
+  virtual void begin() = 0;
+  // Set which pins are inputs (bit set) and which inputs have pullups.
+  virtual void setDirection(const uint16_t inputs, const uint16_t pullups) = 0;
+  virtual void writeOutputs(const uint16_t outputs) = 0;
+  virtual uint16_t readInputs() = 0;
+  // True if the chip has signalled an input change since the last readInputs().
+  virtual bool inputsPending() = 0;
+};
+
+// MCP23017 16 bit I2C expander.
+// Its INTA line (mirrored to both ports) is used to signal input changes.
+class Mcp23017Bus : public ExpanderBus {
+ public:
+  Mcp23017Bus(const uint8_t address_, const uint8_t int_pin_) :
+    address(address_), int_pin(int_pin_) {}
+  void begin();
+  void setDirection(const uint16_t inputs, const uint16_t pullups);
+  void writeOutputs(const uint16_t outputs);
+  uint16_t readInputs();
+  bool inputsPending();
+ private:
+  void writeRegisters(const uint8_t reg, const uint16_t value);
+  uint8_t address;
+  uint8_t int_pin;
+};
+
+// Chain of two 74HC595 shift registers. Outputs only.
+class ShiftRegisterBus : public ExpanderBus {
+ public:
+  ShiftRegisterBus(const uint8_t data_pin_, const uint8_t clock_pin_, const uint8_t latch_pin_) :
+    data_pin(data_pin_), clock_pin(clock_pin_), latch_pin(latch_pin_) {}
+  void begin();
+  void setDirection(const uint16_t, const uint16_t) {}
+  void writeOutputs(const uint16_t outputs);
+  uint16_t readInputs(){ return 0; }
+  bool inputsPending(){ return false; }
+ private:
+  uint8_t data_pin;
+  uint8_t clock_pin;
+  uint8_t latch_pin;
+};
+
+// Virtual pins EXPANDER_PIN_BASE and up, backed by an ExpanderBus.
+// Reads and writes only touch a local copy of the pins. The bus is accessed
+// from Io::loop(): poll() reads all inputs when the chip signals a change and
+// flush() writes all outputs changed since the last flush in one transaction.
+class Expander {
+ public:
+  Expander(ExpanderBus* bus_) : bus(bus_), inputs(0), pullups(0), outputs(0),
+                                written(0), input_state(0), dirty_outputs(false),
+                                dirty_direction(false) {}
+  static bool isVirtual(const uint8_t pin){ return pin >= EXPANDER_PIN_BASE; }
+  void begin();
+  void pinMode(const uint8_t pin, const uint8_t mode);
+  void digitalWrite(const uint8_t pin, const bool value);
+  bool digitalRead(const uint8_t pin) const;
+  // Return true if any input changed.
+  bool poll();
+  void flush();
+ private:
+  ExpanderBus* bus;
+  uint16_t inputs;
+  uint16_t pullups;
+  uint16_t outputs;
+  uint16_t written;
+  uint16_t input_state;
+  bool dirty_outputs;
+  bool dirty_direction;
+};
+
+#endif  // ESP8266__EXPANDER_H
@@ -19,6 +19,7 @@
  * SOFTWARE.
  */
 
+#include <memory>
 #include <ESP8266WiFi.h>
 #include "FS.h"
 
@@ -28,7 +29,6 @@
 #include "tags.h"
 
 extern Config config;
-extern TagRoot root_tag;
 extern TagItterator tag_itterator;
 
 
@@ -117,7 +117,14 @@ void Config::clear(){
   subscribeprefix[0] = '\0';
   publishprefix[0] = '\0';
   for(int i = 0; i < MAX_DEVICES; i++){
-    devices[i] = (const Connected_device){{0},Io_Type::test,0,0,0,false,true};
+    devices[i] = (const Connected_device){{0},Io_Type::test,0,false,true};
+    devices[i].iopin2 = IOPIN_NONE;
+  }
+  devices_in_use = 0;
+  segments.used = 0;
+  solicit_window = 0;
+  for(int i = 0; i < MAX_RULES; i++){
+    rules[i] = (const Rule){RULE_NO_DEVICE,RULE_NO_DEVICE,trigger_change,action_none,0,0};
   }
   firmwarehost[0] = '\0';
   firmwaredirectory[0] = '\0';
@@ -184,7 +191,7 @@ void assemblePathArray(JsonArray& json_object, String& path){
       //Serial.print("\t: ");
       //Serial.println(dataobj.as<char*>());
       TagBase* tag = tag_itterator.getByPath(path);
-      if(tag != nullptr && tag->configurable){
+      if(tag != nullptr && tag->configurable()){
         tag->contentsSave(dataobj.as<char*>());
       }
     } else if(dataobj.is<JsonArray>()){
@@ -208,7 +215,7 @@ void assemblePathObject(JsonObject& json_object, String& path){
       //Serial.print("\t: ");
       //Serial.println(dataobj.value.as<char*>());
       TagBase* tag = tag_itterator.getByPath(path);
-      if(tag != nullptr && tag->configurable){
+      if(tag != nullptr && tag->configurable()){
         tag->contentsSave(dataobj.value.as<char*>());
       }
     } else if(dataobj.value.is<JsonArray>()){
@@ -242,20 +249,18 @@ bool Config::load(const String& filename){
     return false;
   }
 
-  String line;
-  String l;
-  while(file.available()) {
-      l = file.readStringUntil('\n');
-      l.trim();
-      line += l;
-  }
+  // Parsed in place so the strings do not need copying into jsonBuffer.
+  const size_t size = file.size();
+  std::unique_ptr<char[]> line(new char[size +1]);
+  file.readBytes(line.get(), size);
+  line[size] = '\0';
 
   file.close();
   SPIFFS.end();
 
-  StaticJsonBuffer<1500> jsonBuffer;
-  //DynamicJsonBuffer jsonBuffer;
-  JsonObject& root = jsonBuffer.parseObject(line);
+  // Heap rather than stack; a full config is too big for the stack.
+  DynamicJsonBuffer jsonBuffer(CONFIG_JSON_BUFFER);
+  JsonObject& root = jsonBuffer.parseObject(line.get());
   if(!root.success()) {
     Serial.println("parseObject() failed");
     return false;
@@ -294,16 +299,19 @@ bool Config::save(const String& filename){
   SPIFFS.end();
 
   String out_buffer;
-  out_buffer.reserve(1000);
+  out_buffer.reserve(CONFIG_FILE_LEN);
 
   TagBase* path[MAX_TAG_RECURSION] = {nullptr};
   TagBase* path_last[MAX_TAG_RECURSION] = {nullptr};
   uint8_t depth = 0;
 
-  tag_itterator.reset();
+  // Its own itterator so a learn_all in progress carries on undisturbed.
+  TagMemoScope memo;
+  TagItterator itterator;
+  itterator.reset();
   while(true){
-    TagBase* tag = tag_itterator.loop(&depth);
-    if(tag == nullptr || tag->configurable){
+    TagBase* tag = itterator.loop(&depth);
+    if(tag == nullptr || tag->configurable()){
       for(uint8_t i = 0; i < MAX_TAG_RECURSION; i++){
         path[i] = nullptr;
       }
@@ -314,14 +322,14 @@ bool Config::save(const String& filename){
 
       for(int8_t i = MAX_TAG_RECURSION -1; i >= 0; i--){
         if(path[i] != path_last[i] && path_last[i] != nullptr){
-          if(path_last[i]->children_len > 0 && path_last[i]->direct_value == false){
+          if(path_last[i]->children_len() > 0 && path_last[i]->direct_value() == false){
             if(out_buffer.endsWith(",\n")){
               out_buffer.remove(out_buffer.length() -2, 1);
             }
             for(uint8_t j=0; j < i; j++){out_buffer.concat("  ");}
             out_buffer.concat("},\n");
           }
-          if(path_last[i]->contentCount() > 0 && path_last[i]->direct_value == false){
+          if(path_last[i]->contentCount() > 0 && path_last[i]->direct_value() == false){
             if(out_buffer.endsWith(",\n")){
               out_buffer.remove(out_buffer.length() -2, 1);
             }
@@ -349,18 +357,18 @@ bool Config::save(const String& filename){
           }
 
           for(uint8_t j=0; j < i; j++){out_buffer.concat("  ");}
-          if(strcmp(path[i]->name, "root") != 0){
+          if(path[i]->id() != tag_root){
             out_buffer.concat("\"");
-            out_buffer.concat(path[i]->name);
+            out_buffer.concat(path[i]->name());
             out_buffer.concat("\":");
           }
 
-          if(path[i]->contentCount() > 0 && path[i]->direct_value == false){
+          if(path[i]->contentCount() > 0 && path[i]->direct_value() == false){
             for(uint8_t j=0; j < i; j++){out_buffer.concat("  ");}
             out_buffer.concat(" [ ");
           }
 
-          if(path[i]->children_len > 0 && path[i]->direct_value == false){
+          if(path[i]->children_len() > 0 && path[i]->direct_value() == false){
             //for(uint8_t j=0; j < i; j++){out_buffer.concat("  ");}
             out_buffer.concat(" {\n");
           } else {
@@ -404,13 +412,14 @@ bool Config::save(const String& filename){
 }
 
 void Config::insertDevice(Connected_device device){
-  if(device.address_segment[0].segment[0] == '\0'){
+  if(device.address[0] == 0){
     // Not a populated device.
     return;
   }
   for(int i = 0; i < MAX_DEVICES; i++){
-    if(devices[i].address_segment[0].segment[0] == '\0'){
+    if(!deviceInUse(i)){
       memcpy(&(devices[i]), &device, sizeof(device));
+      setDeviceInUse(i, true);
       return;
     }
   }
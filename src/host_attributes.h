@@ -25,6 +25,8 @@
 #include "config.h"
 #include "devices.h"
 
+static_assert(MAX_DEVICES <= 32, "Config::devices_in_use is a 32 bit bitmap.");
+
 struct Config {
   char hostname[HOSTNAME_LEN];
   IPAddress ip;
@@ -47,17 +49,76 @@ struct Config {
   uint32_t session_time;
   bool session_override;
   String files;
+  Rule rules[MAX_RULES];
+  Segment_Pool segments;
+  uint32_t devices_in_use;  // Bitmap of populated entries in devices.
+  uint16_t solicit_window;  // Milliseconds. 0 for SOLICIT_WINDOW.
 
   bool sessionValid();
   bool sessionExpired();
   void clear();
   void insertDevice(Connected_device device);
 
+  bool deviceInUse(const int index) const {
+    return devices_in_use & (1UL << index);
+  }
+
+  void setDeviceInUse(const int index, const bool in_use){
+    if(in_use){
+      devices_in_use |= (1UL << index);
+    } else {
+      devices_in_use &= ~(1UL << index);
+      // The next device in this slot starts without a second pin.
+      devices[index].iopin2 = IOPIN_NONE;
+      // Rules must not follow whichever device takes this slot next.
+      for(int rule = 0; rule < MAX_RULES; rule++){
+        if(rules[rule].input == index){
+          rules[rule].input = RULE_NO_DEVICE;
+        }
+        if(rules[rule].output == index){
+          rules[rule].output = RULE_NO_DEVICE;
+        }
+      }
+    }
+  }
+
+  uint8_t deviceCount() const {
+    return __builtin_popcount(devices_in_use);
+  }
+
   int labelToIndex(const int label){
     int count_valid = -1;
     int empty_slot = -1;
     for(int index = 0; index < MAX_DEVICES; index++){
-      if(strlen(devices[index].address_segment[0].segment) > 0) {
+      if(deviceInUse(index)) {
+        count_valid++;
+        if(count_valid == label){
+          return index;
+        }
+      } else if(empty_slot < 0){
+        empty_slot = index;
+      }
+    }
+    if(empty_slot >= 0){
+      return empty_slot;
+    }
+    return -1;
+  }
+
+  // Inverse of labelToIndex(). -1 if the device at index is not in use.
+  int indexToLabel(const int index) const {
+    if(index < 0 || index >= MAX_DEVICES || !deviceInUse(index)){
+      return -1;
+    }
+    return __builtin_popcount(devices_in_use & ((1UL << index) -1));
+  }
+
+  // As labelToIndex() but for rules.
+  int ruleLabelToIndex(const int label){
+    int count_valid = -1;
+    int empty_slot = -1;
+    for(int index = 0; index < MAX_RULES; index++){
+      if(rules[index].action != action_none) {
         count_valid++;
         if(count_valid == label){
           return index;
@@ -326,6 +326,7 @@ void  HttpServer::onRoot(){
 void HttpServer::onReset() {
   esp8266_http_server.send(200, "text/plain", "restarting host");
   Serial.println("HttpServer::onReset()");
+  mqtt->forceDisconnect();
   delay(100);
   ESP.reset();
 }
@@ -365,6 +366,7 @@ void HttpServer::onFileOperations(const String& _filename){
         // next boot.
         setPullFirmware(true);
 
+        mqtt->forceDisconnect();
         delay(100);
         ESP.reset();
       } else {
@@ -25,8 +25,6 @@
 #include "tags.h"
 
 extern TagItterator tag_itterator;
-extern std::function< void(String&, String&) > tag_itterator_callback;
-extern TaqQueue tag_queue;
 
 
 void parse_tag_name(String& tag_name, String* name_list){
@@ -142,6 +140,25 @@ bool compare_addresses(const Address_Segment* address_1, const Address_Segment*
   }
   return true;
 }
+
+bool compare_addresses(const Address_Segment* address_1, const Connected_device& device){
+  if(device.address[0] == 0){
+    return false;
+  }
+  if(strcmp(address_1[0].segment, "_all") != 0 &&
+      strcmp(address_1[0].segment, DeviceSegment(device, 0)) != 0){
+    return false;
+  }
+  for(int s=1; s < ADDRESS_SEGMENTS; s++){
+    if(strcmp(address_1[s].segment, "_all") == 0){
+      return true;
+    }
+    if(strcmp(address_1[s].segment, DeviceSegment(device, s)) != 0){
+      return false;
+    }
+  }
+  return true;
+}
   
 String valueFromStringPayload(const String& payload, const String& key) {
   StaticJsonBuffer<300> jsonBuffer;
@@ -174,36 +191,197 @@ String value_from_payload(const byte* _payload, const unsigned int length, const
   return valueFromStringPayload(payload, key);
 }
 
+// Apply a list of {"_subject", "_command"} pairs to this host's devices in one
+// pass. Every matching device is announced together by Io::getOutput(), on
+// every transport like any other change of state.
+void actOnGroup(Io* io, Config* config, JsonArray& group)
+{
+  // Commands are applied in order as they are parsed, so only one subject
+  // is held on the stack at a time.
+  Address_Segment subject_segments[ADDRESS_SEGMENTS];
+  char topic_char[MAX_TOPIC_LENGTH];
+  uint32_t matched = 0;  // Bitmap of config->devices.
+  uint8_t command_count = 0;
+  for(auto entry : group){
+    const char* subject = entry["_subject"];
+    const char* command = entry["_command"];
+    if(subject == nullptr || command == nullptr){
+      continue;
+    }
+    if(command_count++ >= MAX_GROUP_COMMANDS){
+      Serial.println("WARNING: Too many commands in group.");
+      break;
+    }
+    if(strlen(subject) >= MAX_TOPIC_LENGTH){
+      Serial.println("WARNING: Subject too long.");
+      continue;
+    }
+    strcpy(topic_char, subject);
+    parse_topic(config->subscribeprefix, topic_char, subject_segments);
+    for (int i = 0; i < MAX_DEVICES; ++i) {
+      if(compare_addresses(subject_segments, config->devices[i])){
+        io->changeState(config->devices[i], command);
+        matched |= (1UL << i);
+      }
+    }
+  }
+
+  io->announceGroup(matched);
+}
+
+// Answers to commands addressed to every host, waiting for this host's turn.
+// One per transport so each answer goes back the way its command came.
+// Repeats of a pending command are merged rather than replacing it.
+struct Deferred_Response {
+  unsigned long due;
+  bool host;
+  bool learn_all;
+  uint32_t learn_since;  // Generation for a "learn_since". 0 for everything.
+  uint32_t devices;  // Bitmap of config->devices still to announce.
+  std::function< void(String&, String&) > callback;
+
+  bool pending() const {
+    return host || learn_all || devices != 0;
+  }
+};
+
+static Deferred_Response deferred[TRANSPORT_COUNT];
+
+// Fixed offset into the solicit window for this host.
+static unsigned long fleetJitter(const unsigned long window){
+  uint8_t mac[6];
+  WiFi.macAddress(mac);
+  uint32_t hash = 2166136261;  // FNV-1a.
+  for(uint8_t i = 0; i < 6; i++){
+    hash ^= mac[i];
+    hash *= 16777619;
+  }
+  return hash % window;
+}
+
+static Deferred_Response& deferResponse(Config* config, const Transport transport,
+                                        std::function< void(String&, String&) > callback){
+  Deferred_Response& response = deferred[transport];
+  if(!response.pending()){
+    const unsigned long window = (config->solicit_window > 0 ?
+                                  config->solicit_window : SOLICIT_WINDOW);
+    response.due = millis() + fleetJitter(window);
+  }
+  response.callback = callback;
+  return response;
+}
+
+void sendDeferredResponses(Io* io, Config* config){
+  for(uint8_t transport = 0; transport < TRANSPORT_COUNT; transport++){
+    Deferred_Response& response = deferred[transport];
+    if(!response.pending() || (long)(millis() - response.due) < 0){
+      continue;
+    }
+
+    if(response.host){
+      response.host = false;
+      String host_topic;
+      String host_payload;
+      toAnnounceHost(config, host_topic, host_payload);
+      response.callback(host_topic, host_payload);
+    } else if(response.learn_all){
+      response.learn_all = false;
+      tagSyncStart(response.learn_since, (Transport)transport, response.callback);
+    } else {
+      // One device per loop so they do not all go out together either.
+      const uint8_t i = __builtin_ctz(response.devices);
+      response.devices &= ~(1UL << i);
+      if(config->deviceInUse(i)){
+        String device_topic;
+        String device_payload;
+        io->toAnnounce(config->devices[i], device_topic, device_payload);
+        response.callback(device_topic, device_payload);
+      }
+    }
+    return;
+  }
+}
+
 void actOnMessage(Io* io, Config* config, String& topic, const String& payload,
-                  std::function< void(String&, String&) > callback)
+                  std::function< void(String&, String&) > callback, const Transport transport)
 {
+  const bool spread = (transport == transport_mqtt);
+
   Serial.print(topic);
   Serial.print(" : ");
   Serial.println(payload);
 
+  // Websocket frames have no length limit of their own so anything bigger
+  // than an MQTT command could be is refused before it reaches the stack.
+  if(payload.length() > COMMAND_PAYLOAD_LEN){
+    Serial.println("WARNING: Payload too long.");
+    return;
+  }
+
+  // Parse the payload once, in place.
+  char payload_char[COMMAND_PAYLOAD_LEN +1];
+  payload.toCharArray(payload_char, COMMAND_PAYLOAD_LEN +1);
+  StaticJsonBuffer<MESSAGE_JSON_BUFFER> jsonBuffer;
+  JsonObject& root = jsonBuffer.parseObject(payload_char);
+  if (!root.success()){
+    Serial.print("parseObject() failed. ");
+    Serial.println(payload);
+    return;
+  }
+  auto valueFromPayload = [&root](const char* key) -> String {
+    if(!root.containsKey(key)){
+      return "";
+    }
+    return root[key].as<String>();
+  };
+
   if(topic == ""){
-    topic = valueFromStringPayload(payload, "_subject");
+    topic = valueFromPayload("_subject");
   }
   if(topic == ""){
     Serial.println("WARNING: Missing topic.");
     return;
   }
-  String command = valueFromStringPayload(payload, "_command");
+  String command = valueFromPayload("_command");
   if(command == ""){
     Serial.println("WARNING: Missing payload.");
     return;
   }
 
+  if(topic.length() >= MAX_TOPIC_LENGTH){
+    Serial.println("WARNING: Topic too long.");
+    return;
+  }
   Address_Segment address_segments[ADDRESS_SEGMENTS];
-  char topic_char[topic.length() +1];
-  topic.toCharArray(topic_char, topic.length() +1);
+  char topic_char[MAX_TOPIC_LENGTH];
+  topic.toCharArray(topic_char, MAX_TOPIC_LENGTH);
   parse_topic(config->subscribeprefix, topic_char, address_segments);
 
   Address_Segment host_all[ADDRESS_SEGMENTS] = {"hosts","_all"};
   Address_Segment host_this[ADDRESS_SEGMENTS] = {"hosts", ""};
   strncpy((char*)(&(host_this[1])), config->hostname, NAME_LEN);
 
-  if(compare_addresses(address_segments, host_all) ||
+  // "learn_since" is "learn_all" skipping tags unchanged since "generation",
+  // so long as that generation came from this boot of this host.
+  uint32_t learn_since = 0;
+  if(command == "learn_since"){
+    command = "learn_all";
+    if(strtoul(valueFromPayload("epoch").c_str(), nullptr, 10) == tag_epoch){
+      learn_since = strtoul(valueFromPayload("generation").c_str(), nullptr, 10);
+    }
+  }
+
+  const bool fleet_wide = spread && compare_addresses(address_segments, host_all);
+  if(fleet_wide && (command == "solicit" || command == "learn_all")){
+    Deferred_Response& response = deferResponse(config, transport, callback);
+    if(command == "solicit"){
+      response.host = true;
+    } else if(!response.learn_all || learn_since < response.learn_since){
+      // A pending full learn_all is not narrowed by a later learn_since.
+      response.learn_all = true;
+      response.learn_since = learn_since;
+    }
+  } else if(compare_addresses(address_segments, host_all) ||
       compare_addresses(address_segments, host_this)){
     if(command == "solicit"){
       //Serial.println("Announce host.");
@@ -212,37 +390,68 @@ void actOnMessage(Io* io, Config* config, String& topic, const String& payload,
       toAnnounceHost(config, host_topic, host_payload);
       callback(host_topic, host_payload);
     } else if(command == "learn_all"){
-      tag_itterator.reset();
-      tag_itterator_callback = callback;
-      tag_queue.clear();
+      tagSyncStart(learn_since, transport, callback);
     } else if(command == "update"){
-      String path = valueFromStringPayload(payload, "path");
-      String value = valueFromStringPayload(payload, "value");
-      TagBase* tag = tag_itterator.getByPath(path);
-      tag->contentsSave(value);
-      tag->sendData(callback);
-      config->save();  // TODO: Batch these so it does not happen every time.
+      // Either "path_id" from a "teach" or the dotted "path".
+      String path_id = valueFromPayload("path_id");
+      String value = valueFromPayload("value");
+      TagBase* tag;
+      if(path_id != ""){
+        tag = tagByPathId(strtoul(path_id.c_str(), nullptr, 10));
+      } else {
+        tag = tag_itterator.getByPath(valueFromPayload("path"));
+      }
+      if(tag != nullptr){
+        tag->contentsSave(value);
+        tag->sendData(callback);
+        config->save();  // TODO: Batch these so it does not happen every time.
+      }
       // TODO: Perform setup on IO if it's settings change.
+    } else if(command == "group"){
+      JsonArray& group = root["_group"];
+      actOnGroup(io, config, group);
+    } else if(command == "subscribe"){
+      const String interval = valueFromPayload("interval");
+      tagSubscribe(valueFromPayload("pattern").c_str(),
+                   interval == "" ? 1000 : interval.toInt(), transport, callback);
+    } else if(command == "unsubscribe"){
+      tagUnsubscribe(valueFromPayload("pattern").c_str(), transport);
     } else if(command == "learn"){
     } else if(command == "ack"){
-      String incoming_id = valueFromStringPayload(payload, "id");
-      String incoming_sequence = valueFromStringPayload(payload, "sequence");
-      //Serial.printf("incoming_id: %s\n", incoming_id.c_str());
-      uint16_t incoming_id_num = incoming_id.toInt();
-      uint8_t incoming_sequence_num = incoming_sequence.toInt();
-      if(incoming_id == "0" || incoming_id_num > 0){
-        tag_queue.dequeue(incoming_id_num, incoming_sequence_num);
+      String incoming_frame = valueFromPayload("frame");
+      String incoming_path_id = valueFromPayload("path_id");
+      if(incoming_frame != ""){
+        // Cumulative frame with a selective ack bitmap of the frames after it.
+        tagSyncAck(strtoul(valueFromPayload("session").c_str(), nullptr, 10),
+                   strtoul(incoming_frame.c_str(), nullptr, 10),
+                   strtoul(valueFromPayload("sack").c_str(), nullptr, 10));
+      } else if(incoming_path_id != ""){
+        tagSyncDequeue(strtoul(incoming_path_id.c_str(), nullptr, 10));
+      } else {
+        // Older clients only echo "id" and "sequence", the low 16 bits of
+        // the path ID.
+        String incoming_id = valueFromPayload("id");
+        String incoming_sequence = valueFromPayload("sequence");
+        //Serial.printf("incoming_id: %s\n", incoming_id.c_str());
+        uint16_t incoming_id_num = incoming_id.toInt();
+        uint8_t incoming_sequence_num = incoming_sequence.toInt();
+        if(incoming_id == "0" || incoming_id_num > 0){
+          tagSyncDequeue(incoming_id_num | (uint32_t)incoming_sequence_num << 8, 0xFFFF);
+        }
       }
     }
   }
 
   for (int i = 0; i < MAX_DEVICES; ++i) {
-		if(compare_addresses(address_segments, config->devices[i].address_segment)){
+		if(compare_addresses(address_segments, config->devices[i])){
       //Serial.print("Matches: ");
 			//Serial.println(i);
 
 			if(command != "solicit"){
 				io->changeState(config->devices[i], command);
+      } else if(spread && strcmp(address_segments[0].segment, "_all") == 0){
+        deferResponse(config, transport, callback).devices |= (1UL << i);
+        continue;
       }
 
       String host_topic;
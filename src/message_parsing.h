@@ -39,15 +39,24 @@
 //void parse_tag_name(const char* tag_name, String* name_list);
 
 bool compare_addresses(const Address_Segment* address_1, const Address_Segment* address_2);
+// As above but against the interned address of a configured device.
+bool compare_addresses(const Address_Segment* address_1, const Connected_device& device);
 
 // Presuming payload is JSON formatted, return value for corresponding key.
 String valueFromStringPayload(const String& payload, const String& key);
 String value_from_payload(const byte* payload, const unsigned int length, const String key);
 
+// Over MQTT, answers to a "solicit" or "learn_all" addressed to every host
+// are deferred and sent later by sendDeferredResponses().
 void actOnMessage(Io* io, Config* config, String& topic, const String& payload,
-                  std::function< void(String&, String&) > callback);
+                  std::function< void(String&, String&) > callback,
+                  const Transport transport=transport_websocket);
                   //String* return_topics, String* return_payloads);
 
 void toAnnounceHost(Config* config, String& topic, String& payload);
 
+// Send at most one deferred answer, once this host's turn has come.
+// Call every loop.
+void sendDeferredResponses(Io* io, Config* config);
+
 #endif  // ESP8266__MESSAGE_PARSING_H
@@ -44,6 +44,12 @@ void Mqtt::loop(){
       Serial.print("-");
     }
     delay(10);
+  } else if(reconnect_pending){
+    reconnect_pending = false;
+    Serial.println("MQTT reconnecting with new config.");
+    // An empty retained message removes the status under the old topic.
+    mqtt_client.publish(status_topic, (const uint8_t*)"", 0, true);
+    mqtt_client.disconnect();
   } else {
     if (!was_connected){
       // Serial.println("MQTT connected.");
@@ -57,30 +63,137 @@ void Mqtt::loop(){
 
 // Called whenever a MQTT topic we are subscribed to arrives.
 void Mqtt::callback(const char* _topic, const byte* _payload, const unsigned int length) {
-  String topic(_topic);
-  Serial.print("Message arrived [");
-  Serial.print(topic);
-  Serial.print("] ");
+  if(command_count >= COMMAND_QUEUE_LEN){
+    command_drops++;
+    Serial.print("Command queue full. Dropped: ");
+    Serial.println(_topic);
+    return;
+  }
+  if(strlen(_topic) >= MAX_TOPIC_LENGTH || length >= COMMAND_PAYLOAD_LEN){
+    command_drops++;
+    Serial.print("Command too long. Dropped: ");
+    Serial.println(_topic);
+    return;
+  }
 
-  String payload;
-  for (unsigned int i = 0; i < length; i++) {
-    payload += (char)_payload[i];
+  Mqtt_Command& command = commands[(command_head + command_count) % COMMAND_QUEUE_LEN];
+  strcpy(command.topic, _topic);
+  memcpy(command.payload, _payload, length);
+  command.payload[length] = '\0';
+  command.received_at = millis();
+
+  command_count++;
+  if(command_count > command_depth_max){
+    command_depth_max = command_count;
   }
-  Serial.println(payload);
+}
+
+void Mqtt::dispatchCommands(){
+  const unsigned long started = millis();
+  while(command_count > 0){
+    Mqtt_Command& command = commands[command_head];
+    command_head = (command_head +1) % COMMAND_QUEUE_LEN;
+    command_count--;
+
+    command_latency = millis() - command.received_at;
+    if(command_latency > command_latency_max){
+      command_latency_max = command_latency;
+    }
+
+    String topic(command.topic);
+    String payload(command.payload);
+    Serial.print("Message arrived [");
+    Serial.print(topic);
+    Serial.print("] ");
+    Serial.println(payload);
+
+    auto publish_callback = [&](String& t, String& p) {publish(t, p);};  
+    actOnMessage(&io, &config, topic, payload, publish_callback, transport_mqtt);
+
+    if(millis() - started >= COMMAND_DISPATCH_BUDGET){
+      break;
+    }
+  }
+}
+
+void Mqtt::forceDisconnect(){
+  if(!connected()){
+    return;
+  }
+  String payload;
+  statusPayload(payload, "offline");
+  publish(status_topic, payload.c_str(), true);
+  mqtt_client.disconnect();
+}
 
-  auto publish_callback = [&](String& t, String& p) {publish(t, p);};  
-  actOnMessage(&io, &config, topic, payload, publish_callback);
+void Mqtt::statusPayload(String& payload, const char* status){
+  String topic;
+  toAnnounceHost(&config, topic, payload);
+  payload.remove(payload.length() -1);
+  payload += ", \"_status\":\"";
+  payload += status;
+  payload += "\"}";
 }
 
 void Mqtt::publish(const String topic, const String payload){
-  if(!connected() || topic == "" || payload == ""){
+  publish(topic.c_str(), payload.c_str());
+}
+
+void Mqtt::publish(const char* topic, const char* payload, const bool retained){
+  if(!connected() || topic[0] == '\0' || payload[0] == '\0'){
     return;
   }
   Serial.print("publish: ");
   Serial.print(topic);
   Serial.print("  :  ");
   Serial.println(payload);
-  mqtt_client.publish(topic.c_str(), payload.c_str());
+
+  // Fixed header, topic length and topic come before the payload in the buffer.
+  const size_t payload_len = strlen(payload);
+  if(5 + 2 + strlen(topic) + payload_len > MQTT_BUFFER_SIZE){
+    publishStream(topic, payload_len, [&payload](uint8_t* buffer, const size_t buffer_len) {
+      const size_t len = strnlen(payload, buffer_len);
+      memcpy(buffer, payload, len);
+      payload += len;
+      return len;
+    }, retained);
+    return;
+  }
+  mqtt_client.publish(topic, (const uint8_t*)payload, payload_len, retained);
+}
+
+bool Mqtt::publishStream(const char* topic, const uint32_t length,
+                         std::function< size_t(uint8_t*, const size_t) > producer,
+                         const bool retained)
+{
+  if(!connected() || !mqtt_client.beginPublish(topic, length, retained)){
+    return false;
+  }
+  uint8_t chunk[MQTT_STREAM_CHUNK];
+  uint32_t sent = 0;
+  bool ended_early = false;
+  while(sent < length){
+    const size_t want = min((uint32_t)MQTT_STREAM_CHUNK, length - sent);
+    size_t len = ended_early ? 0 : producer(chunk, want);
+    if(len == 0){
+      // The header has promised length bytes so the broker must get them.
+      if(!ended_early){
+        Serial.println("Error. Streamed payload ended early.");
+        ended_early = true;
+      }
+      memset(chunk, ' ', want);
+      len = want;
+    }
+    if(mqtt_client.write(chunk, len) != len){
+      // The broker is still waiting for the rest of the packet so nothing
+      // else can be sent on this connection.
+      Serial.println("Error. Short write while streaming payload.");
+      mqtt_client.disconnect();
+      return false;
+    }
+    sent += len;
+  }
+  return mqtt_client.endPublish() && !ended_early;
 }
 
 void Mqtt::queue_mqtt_subscription(const char* path){
@@ -130,7 +243,15 @@ void Mqtt::connect() {
   mqtt_client.setServer(ip, port);
   mqtt_client.setCallback(registered_callback);
 
-  if (mqtt_client.connect(config.hostname)) {
+  snprintf(status_topic, MAX_TOPIC_LENGTH, "%s/hosts/%s/_status",
+           config.publishprefix, config.hostname);
+
+  // Last Will in the same shape as the birth message below.
+  String will;
+  statusPayload(will, "offline");
+
+  if (mqtt_client.connect(config.hostname, status_topic, 0, true, will.c_str())) {
+    reconnect_pending = false;
     if(mqtt_subscribed_count > 0){
       // In the event this is a re-connection, clear the subscription buffer.
       mqtt_clear_buffers();
@@ -152,7 +273,7 @@ void Mqtt::connect() {
     queue_mqtt_subscription(address);
 
     for (int i = 0; i < MAX_DEVICES; ++i) {
-      if (strlen(config.devices[i].address_segment[0].segment) > 0) {
+      if (config.deviceInUse(i)) {
         String fetch_topic;
         String fetch_payload;
 				io.toAnnounce(config.devices[i], fetch_topic, fetch_payload);
@@ -162,14 +283,14 @@ void Mqtt::connect() {
         strncat(address, "/_all", MAX_TOPIC_LENGTH -1 - strlen(address));
 
         for(int j = 0; j < ADDRESS_SEGMENTS; j++){
-          if(strlen(config.devices[i].address_segment[j].segment) <= 0) {
+          if(DeviceSegment(config.devices[i], j)[0] == '\0') {
             break;
           }
           address[strlen(address) -4] = '\0';
-          strncat(address, config.devices[i].address_segment[j].segment,
+          strncat(address, DeviceSegment(config.devices[i], j),
                   MAX_TOPIC_LENGTH -1 - strlen(address));
           if (j < (ADDRESS_SEGMENTS -1) &&
-              strlen(config.devices[i].address_segment[j +1].segment) > 0) {
+              DeviceSegment(config.devices[i], j +1)[0] != '\0') {
             strncat(address, "/_all", MAX_TOPIC_LENGTH -1 - strlen(address));
           }
           queue_mqtt_subscription(address);
@@ -180,6 +301,11 @@ void Mqtt::connect() {
     String host_payload;
     toAnnounceHost(&config, host_topic, host_payload);
     publish(host_topic, host_payload);
+
+    // Birth message. Retained so controllers learn which hosts are up
+    // without soliciting them.
+    statusPayload(host_payload, "online");
+    publish(status_topic, host_payload.c_str(), true);
   }
   brokers->RateHost(mqtt_client.connected());
   
@@ -31,6 +31,13 @@
 #include "mdns_actions.h"
 
 
+// An inbound message waiting to be acted on.
+struct Mqtt_Command {
+  char topic[MAX_TOPIC_LENGTH];
+  char payload[COMMAND_PAYLOAD_LEN];
+  unsigned long received_at;
+};
+
 class Mqtt{
  public:
   Mqtt(WiFiClient& wifi_client, MdnsLookup* brokers_) : 
@@ -39,16 +46,41 @@ class Mqtt{
       mqtt_subscription_count(0),
       mqtt_subscribed_count(0),
       was_connected(false),
-      count_loop(0) 
+      reconnect_pending(false),
+      count_loop(0),
+      command_head(0),
+      command_count(0),
+      command_drops(0),
+      command_depth_max(0),
+      command_latency(0),
+      command_latency_max(0)
   {
-    mqtt_client.setBufferSize(255);
+    mqtt_client.setBufferSize(MQTT_BUFFER_SIZE);
+    status_topic[0] = '\0';
   };
 
   // Called whenever a MQTT topic we are subscribed to arrives.
+  // Only queues the message. PubSubClient is still part way through its
+  // receive buffer so nothing that could publish or block happens here.
   void callback(const char* topic, const byte* payload, const unsigned int length);
 
+  // Act on queued messages for up to COMMAND_DISPATCH_BUDGET milliseconds.
+  // Call from the main loop.
+  void dispatchCommands();
+
   // Publish a payload to a topic.
+  // Payloads too big for PubSubClient's buffer are streamed.
   void publish(const String topic, const String payload);
+  void publish(const char* topic, const char* payload, const bool retained=false);
+
+  // Publish length bytes without buffering the whole payload.
+  // producer fills the buffer it is given and returns the number of bytes
+  // written. It is called until length bytes have been sent.
+  // A short write to the socket leaves the packet incomplete so drops the
+  // connection.
+  bool publishStream(const char* topic, const uint32_t length,
+                     std::function< size_t(uint8_t*, const size_t) > producer,
+                     const bool retained=false);
 
   // Assemble a list of topics we want to subscribe to.
   void queue_mqtt_subscription(const char* path);
@@ -62,7 +94,13 @@ class Mqtt{
   void connect();
 
   bool connected(){ return mqtt_client.connected(); }
-  void forceDisconnect(){ mqtt_client.disconnect(); }
+  // Disconnect cleanly. The broker does not send the Last Will for a clean
+  // disconnect so publish "offline" ourselves first.
+  void forceDisconnect();
+  // Call when the hostname or publish prefix changes. From the next loop()
+  // the retained status under the old topic is cleared and the connection
+  // re-made under the new one.
+  void reconfigure(){ reconnect_pending = true; }
   void loop();
   void registerCallback(void (*registered_callback_)(const char* topic,
                                                      const byte* payload,
@@ -74,11 +112,26 @@ class Mqtt{
   PubSubClient mqtt_client;
   MdnsLookup* brokers;
   char mqtt_subscriptions[MAX_TOPIC_LENGTH * MAX_SUBSCRIPTIONS];
+  // Retained "online" when connected, "offline" from the broker's Last Will otherwise.
+  char status_topic[MAX_TOPIC_LENGTH];
+  // The host's "_announce" payload with "_status" added.
+  void statusPayload(String& payload, const char* status);
   int mqtt_subscription_count;
   int mqtt_subscribed_count;
   void (*registered_callback)(const char* topic, const byte* payload, const unsigned int length);
   bool was_connected;
+  bool reconnect_pending;
   unsigned int count_loop;
+  Mqtt_Command commands[COMMAND_QUEUE_LEN];
+  uint8_t command_head;
+  uint8_t command_count;
+
+ public:
+  uint32_t command_drops;          // Messages lost because the queue was full.
+  uint8_t command_depth_max;
+  uint32_t command_latency;        // Milliseconds the last message spent queued.
+  uint32_t command_latency_max;
+  uint8_t commandDepth(){ return command_count; }
 };
 
 
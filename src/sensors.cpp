@@ -0,0 +1,133 @@
+/* Copyright 2017 Duncan Law (mrdunk@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "sensors.h"
+
+HardwareSensorBus hardware_sensor_bus;
+
+// 1-Wire timings from Maxim application note 126.
+// Interrupts are only disabled for the duration of a single bit.
+
+bool HardwareSensorBus::oneWireReset(const uint8_t pin){
+  pinMode(pin, INPUT);
+  noInterrupts();
+  digitalWrite(pin, LOW);
+  pinMode(pin, OUTPUT);
+  interrupts();
+  delayMicroseconds(480);
+  noInterrupts();
+  pinMode(pin, INPUT);
+  delayMicroseconds(70);
+  const bool present = (digitalRead(pin) == LOW);
+  interrupts();
+  delayMicroseconds(410);
+  return present;
+}
+
+void HardwareSensorBus::oneWireWrite(const uint8_t pin, const uint8_t value){
+  for(uint8_t bit = 0; bit < 8; bit++){
+    const bool one = value & (1 << bit);
+    noInterrupts();
+    digitalWrite(pin, LOW);
+    pinMode(pin, OUTPUT);
+    delayMicroseconds(one ? 6 : 60);
+    pinMode(pin, INPUT);
+    interrupts();
+    delayMicroseconds(one ? 64 : 10);
+  }
+}
+
+uint8_t HardwareSensorBus::oneWireRead(const uint8_t pin){
+  uint8_t value = 0;
+  for(uint8_t bit = 0; bit < 8; bit++){
+    noInterrupts();
+    digitalWrite(pin, LOW);
+    pinMode(pin, OUTPUT);
+    delayMicroseconds(6);
+    pinMode(pin, INPUT);
+    delayMicroseconds(9);
+    if(digitalRead(pin) == HIGH){
+      value |= (1 << bit);
+    }
+    interrupts();
+    delayMicroseconds(55);
+  }
+  return value;
+}
+
+// A DHT22 reply is a falling edge at the start of its 80us preamble, another
+// at the start of the first bit, then one at the end of each of the 40 bits.
+// A bit is a 50us low followed by a 26us high for 0 or a 70us high for 1,
+// so the time between falling edges gives the bit value.
+#define DHT_EDGES 42
+#define DHT_ONE_US 100
+
+static volatile uint32_t dht_edges[DHT_EDGES];
+static volatile uint8_t dht_edge_count;
+
+static void ICACHE_RAM_ATTR onDhtEdge(){
+  if(dht_edge_count < DHT_EDGES){
+    dht_edges[dht_edge_count++] = micros();
+  }
+}
+
+void HardwareSensorBus::dhtStart(const uint8_t pin){
+  detachInterrupt(digitalPinToInterrupt(pin));
+  digitalWrite(pin, LOW);
+  pinMode(pin, OUTPUT);
+}
+
+void HardwareSensorBus::dhtListen(const uint8_t pin){
+  dht_edge_count = 0;
+  pinMode(pin, INPUT_PULLUP);
+  attachInterrupt(digitalPinToInterrupt(pin), onDhtEdge, FALLING);
+}
+
+bool HardwareSensorBus::dhtRead(const uint8_t pin, uint8_t* data){
+  if(dht_edge_count < DHT_EDGES){
+    return false;
+  }
+  detachInterrupt(digitalPinToInterrupt(pin));
+  memset(data, 0, 5);
+  for(uint8_t bit = 0; bit < 40; bit++){
+    if(dht_edges[bit +2] - dht_edges[bit +1] > DHT_ONE_US){
+      data[bit / 8] |= (0x80 >> (bit % 8));
+    }
+  }
+  return true;
+}
+
+
+uint8_t oneWireCrc8(const uint8_t* data, uint8_t len){
+  uint8_t crc = 0;
+  while(len--){
+    uint8_t byte = *data++;
+    for(uint8_t bit = 0; bit < 8; bit++){
+      const uint8_t mix = (crc ^ byte) & 0x01;
+      crc >>= 1;
+      if(mix){
+        crc ^= 0x8C;
+      }
+      byte >>= 1;
+    }
+  }
+  return crc;
+}
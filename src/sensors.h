@@ -0,0 +1,70 @@
+/* Copyright 2017 Duncan Law (mrdunk@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ESP8266__SENSORS_H
+#define ESP8266__SENSORS_H
+
+#include <Arduino.h>
+#include "config.h"
+
+#define DS18B20_SKIP_ROM 0xCC
+#define DS18B20_CONVERT 0x44
+#define DS18B20_READ_SCRATCHPAD 0xBE
+// Time taken by a 12 bit conversion.
+#define DS18B20_CONVERSION_MS 750
+
+// Wire level access to DS18B20 (1-Wire) and DHT22 sensors.
+// No call may wait for a sensor to finish a conversion. Each should return
+// within SENSOR_STEP_BUDGET_US so Io::loop() never stalls for long.
+class SensorBus {
+ public:
+  virtual ~SensorBus(){}
+  // 1-Wire primitives. A reset takes about 1ms and a byte about 0.6ms.
+  // Returns true if a device answered the reset.
+  virtual bool oneWireReset(const uint8_t pin) = 0;
+  virtual void oneWireWrite(const uint8_t pin, const uint8_t value) = 0;
+  virtual uint8_t oneWireRead(const uint8_t pin) = 0;
+  // DHT22. dhtStart() pulls the line low. At least 1ms later dhtListen()
+  // releases it and the reply is captured in the background.
+  // dhtRead() returns true once all 5 bytes of the reply have arrived.
+  virtual void dhtStart(const uint8_t pin) = 0;
+  virtual void dhtListen(const uint8_t pin) = 0;
+  virtual bool dhtRead(const uint8_t pin, uint8_t* data) = 0;
+};
+
+// Bit banged on the ESP8266's GPIO pins.
+// 1-Wire needs a 4.7K pullup resistor on the data line.
+class HardwareSensorBus : public SensorBus {
+ public:
+  bool oneWireReset(const uint8_t pin);
+  void oneWireWrite(const uint8_t pin, const uint8_t value);
+  uint8_t oneWireRead(const uint8_t pin);
+  void dhtStart(const uint8_t pin);
+  void dhtListen(const uint8_t pin);
+  bool dhtRead(const uint8_t pin, uint8_t* data);
+};
+
+// Dallas/Maxim CRC used by 1-Wire devices.
+uint8_t oneWireCrc8(const uint8_t* data, uint8_t len);
+
+extern HardwareSensorBus hardware_sensor_bus;
+
+#endif  // ESP8266__SENSORS_H
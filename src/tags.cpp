@@ -0,0 +1,879 @@
+/* Copyright 2017 Duncan Law (mrdunk@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "tags.h"
+
+Config* TagHandler::config = nullptr;
+MdnsLookup* TagHandler::brokers = nullptr;
+mdns::MDns* TagHandler::mdns = nullptr;
+Mqtt* TagHandler::mqtt = nullptr;
+Io* TagHandler::io = nullptr;
+
+TagBase tags[TAG_COUNT];
+
+uint32_t tag_generation = 1;
+uint32_t tag_epoch = 0;
+
+TagMemo tag_memo;
+
+// {name, parent, first_child, children_len, flags, handlers}
+constexpr Tag_Node tag_nodes[TAG_COUNT] PROGMEM = {
+  {"root", tag_root, tag_host, 8, 0, TAG_HANDLERS(TagHandler)},
+  {"host", tag_root, tag_host_hostname, 11, 0, TAG_HANDLERS(TagHandler)},
+  {"session", tag_root, tag_session_valid, 6, 0, TAG_HANDLERS(TagHandler)},
+  {"servers", tag_root, tag_servers_mqtt, 1, 0, TAG_HANDLERS(TagHandler)},
+  {"mdns", tag_root, tag_mdns_buffer_success, 5, 0, TAG_HANDLERS(TagHandler)},
+  {"fs", tag_root, tag_fs_files, 2, 0, TAG_HANDLERS(TagHandler)},
+  {"io", tag_root, tag_io_index, 13, 0, TAG_HANDLERS(TagIo)},
+  {"rules", tag_root, tag_rules_input, 6, 0, TAG_HANDLERS(TagRules)},
+  {"sensors", tag_root, tag_sensors_step_max_us, 3, 0, TAG_HANDLERS(TagHandler)},
+  {"hostname", tag_host, 0, 0, TAG_CONFIGURABLE, TAG_HANDLERS(TagHostHostname)},
+  {"mac", tag_host, 0, 0, 0, TAG_HANDLERS(TagHostMac)},
+  {"uptime", tag_host, 0, 0, 0, TAG_HANDLERS(TagHostUptime)},
+  {"rssi", tag_host, 0, 0, 0, TAG_HANDLERS(TagHostRssi)},
+  {"core", tag_host, tag_host_core_cpu_speed, 14, 0, TAG_HANDLERS(TagHandler)},
+  {"nw", tag_host, tag_host_nw_address, 3, 0, TAG_HANDLERS(TagHandler)},
+  {"nwconfigured", tag_host, tag_host_nwconfigured_address, 3, 0, TAG_HANDLERS(TagHandler)},
+  {"ssids", tag_host, tag_host_ssids_name, 2, 0, TAG_HANDLERS(TagHostSsids)},
+  {"mqtt", tag_host, tag_host_mqtt_broker, 5, 0, TAG_HANDLERS(TagHandler)},
+  {"http", tag_host, tag_host_http_address, 3, 0, TAG_HANDLERS(TagHandler)},
+  {"announce_suppressed", tag_host, 0, 0, 0, TAG_HANDLERS(TagHostAnnouncesuppressed)},
+  {"valid", tag_session, 0, 0, 0, TAG_HANDLERS(TagSessionValid)},
+  {"validuntil", tag_session, 0, 0, 0, TAG_HANDLERS(TagSessionValiduntil)},
+  {"providedtoken", tag_session, 0, 0, 0, TAG_HANDLERS(TagSessionProvidedtoken)},
+  {"expectedtoken", tag_session, 0, 0, 0, TAG_HANDLERS(TagSessionExpectedtoken)},
+  {"overrideauth", tag_session, 0, 0, 0, TAG_HANDLERS(TagSessionOverrideauth)},
+  {"enable", tag_session, tag_session_enable_iopin, 2, 0, TAG_HANDLERS(TagHandler)},
+  {"mqtt", tag_servers, tag_servers_mqtt_active, 10, 0, TAG_HANDLERS(TagServersMqtt)},
+  {"buffer_success", tag_mdns, 0, 0, 0, TAG_HANDLERS(TagMdnsBuffersuccess)},
+  {"packet_count", tag_mdns, 0, 0, 0, TAG_HANDLERS(TagMdnsPacketcount)},
+  {"success_rate", tag_mdns, 0, 0, 0, TAG_HANDLERS(TagMdnsSuccessrate)},
+  {"largest_packet", tag_mdns, 0, 0, 0, TAG_HANDLERS(TagMdnsLargestpacket)},
+  {"buffer_size", tag_mdns, 0, 0, 0, TAG_HANDLERS(TagMdnsBuffersize)},
+  {"files", tag_fs, tag_fs_files_filename, 3, 0, TAG_HANDLERS(TagFsFiles)},
+  {"space", tag_fs, tag_fs_space_size, 5, 0, TAG_HANDLERS(TagHandler)},
+  {"index", tag_io, 0, 0, 0, TAG_HANDLERS(TagIoIndex)},
+  {"topic", tag_io, 0, 0, TAG_CONFIGURABLE, TAG_HANDLERS(TagIoTopic)},
+  {"inverted", tag_io, 0, 0, 0, TAG_HANDLERS(TagIoInverted)},
+  {"default", tag_io, 0, 0, TAG_CONFIGURABLE, TAG_HANDLERS(TagIoDefault)},
+  {"iopin", tag_io, tag_io_iopin_value, 2, TAG_CONFIGURABLE | TAG_DIRECT_VALUE, TAG_HANDLERS(TagUiIopin)},
+  {"iotype", tag_io, tag_io_iotype_value, 2, TAG_CONFIGURABLE | TAG_DIRECT_VALUE, TAG_HANDLERS(TagUiIotype)},
+  {"sample_interval", tag_io, 0, 0, TAG_CONFIGURABLE, TAG_HANDLERS(TagIoSampleinterval)},
+  {"interval", tag_io, 0, 0, TAG_CONFIGURABLE, TAG_HANDLERS(TagIoInterval)},
+  {"deadband", tag_io, 0, 0, TAG_CONFIGURABLE, TAG_HANDLERS(TagIoDeadband)},
+  {"iopin2", tag_io, 0, 0, TAG_CONFIGURABLE, TAG_HANDLERS(TagIoIopin2)},
+  {"rate_limit", tag_io, 0, 0, TAG_CONFIGURABLE, TAG_HANDLERS(TagIoRatelimit)},
+  {"suppressed", tag_io, 0, 0, 0, TAG_HANDLERS(TagIoSuppressed)},
+  {"state", tag_io, 0, 0, 0, TAG_HANDLERS(TagIoState)},
+  {"input", tag_rules, 0, 0, TAG_CONFIGURABLE, TAG_HANDLERS(TagRulesInput)},
+  {"output", tag_rules, 0, 0, TAG_CONFIGURABLE, TAG_HANDLERS(TagRulesOutput)},
+  {"trigger", tag_rules, 0, 0, TAG_CONFIGURABLE, TAG_HANDLERS(TagRulesTrigger)},
+  {"action", tag_rules, 0, 0, TAG_CONFIGURABLE, TAG_HANDLERS(TagRulesAction)},
+  {"value", tag_rules, 0, 0, TAG_CONFIGURABLE, TAG_HANDLERS(TagRulesValue)},
+  {"duration", tag_rules, 0, 0, TAG_CONFIGURABLE, TAG_HANDLERS(TagRulesDuration)},
+  {"step_max_us", tag_sensors, 0, 0, 0, TAG_HANDLERS(TagSensorsStepmaxus)},
+  {"overruns", tag_sensors, 0, 0, 0, TAG_HANDLERS(TagSensorsOverruns)},
+  {"budget_us", tag_sensors, 0, 0, 0, TAG_HANDLERS(TagSensorsBudgetus)},
+  {"cpu_speed", tag_host_core, 0, 0, 0, TAG_HANDLERS(TagHostCoreCpuspeed)},
+  {"flash_size", tag_host_core, 0, 0, 0, TAG_HANDLERS(TagHostCoreFlashsize)},
+  {"flash_free", tag_host_core, 0, 0, 0, TAG_HANDLERS(TagHostCoreFlashfree)},
+  {"flash_ratio", tag_host_core, 0, 0, 0, TAG_HANDLERS(TagHostCoreFlashratio)},
+  {"flash_speed", tag_host_core, 0, 0, 0, TAG_HANDLERS(TagHostCoreFlashspeed)},
+  {"ram_free", tag_host_core, 0, 0, 0, TAG_HANDLERS(TagHostCoreRamfree)},
+  {"sdk_version", tag_host_core, 0, 0, 0, TAG_HANDLERS(TagHostCoreSdkversion)},
+  {"core_version", tag_host_core, 0, 0, 0, TAG_HANDLERS(TagHostCoreCoreversion)},
+  {"reset_reason", tag_host_core, 0, 0, 0, TAG_HANDLERS(TagHostCoreResetreason)},
+  {"chip_id", tag_host_core, 0, 0, 0, TAG_HANDLERS(TagHostCoreChipid)},
+  {"cpu_cycles", tag_host_core, 0, 0, 0, TAG_HANDLERS(TagHostCoreCpucycles)},
+  {"uptime", tag_host_core, 0, 0, 0, TAG_HANDLERS(TagHostCoreUptime)},
+  {"memo_hits", tag_host_core, 0, 0, 0, TAG_HANDLERS(TagHostCoreMemohits)},
+  {"memo_misses", tag_host_core, 0, 0, 0, TAG_HANDLERS(TagHostCoreMemomisses)},
+  {"address", tag_host_nw, 0, 0, 0, TAG_HANDLERS(TagHostNwAddress)},
+  {"gateway", tag_host_nw, 0, 0, 0, TAG_HANDLERS(TagHostNwGateway)},
+  {"subnet", tag_host_nw, 0, 0, 0, TAG_HANDLERS(TagHostNwSubnet)},
+  {"address", tag_host_nwconfigured, 0, 0, TAG_CONFIGURABLE, TAG_HANDLERS(TagHostNwconfiguredAddress)},
+  {"gateway", tag_host_nwconfigured, 0, 0, TAG_CONFIGURABLE, TAG_HANDLERS(TagHostNwconfiguredGateway)},
+  {"subnet", tag_host_nwconfigured, 0, 0, TAG_CONFIGURABLE, TAG_HANDLERS(TagHostNwconfiguredSubnet)},
+  {"name", tag_host_ssids, 0, 0, TAG_MEMOISE, TAG_HANDLERS(TagHostSsidsName)},
+  {"signal", tag_host_ssids, 0, 0, TAG_MEMOISE, TAG_HANDLERS(TagHostSsidsSignal)},
+  {"broker", tag_host_mqtt, tag_host_mqtt_broker_address, 2, 0, TAG_HANDLERS(TagHandler)},
+  {"subscribe_prefix", tag_host_mqtt, 0, 0, TAG_CONFIGURABLE, TAG_HANDLERS(TagHostMqttSubscriptionprefix)},
+  {"publish_prefix", tag_host_mqtt, 0, 0, TAG_CONFIGURABLE, TAG_HANDLERS(TagHostMqttPublishprefix)},
+  {"solicit_window", tag_host_mqtt, 0, 0, TAG_CONFIGURABLE, TAG_HANDLERS(TagHostMqttSolicitwindow)},
+  {"commands", tag_host_mqtt, tag_host_mqtt_commands_depth, 5, 0, TAG_HANDLERS(TagHandler)},
+  {"address", tag_host_http, 0, 0, TAG_CONFIGURABLE, TAG_HANDLERS(TagHostHttpAddress)},
+  {"port", tag_host_http, 0, 0, TAG_CONFIGURABLE, TAG_HANDLERS(TagHostHttpPort)},
+  {"directory", tag_host_http, 0, 0, TAG_CONFIGURABLE, TAG_HANDLERS(TagHostHttpDirectory)},
+  {"iopin", tag_session_enable, tag_session_enable_iopin_value, 2, TAG_CONFIGURABLE | TAG_DIRECT_VALUE, TAG_HANDLERS(TagUiIopin)},
+  {"password", tag_session_enable, 0, 0, TAG_CONFIGURABLE, TAG_HANDLERS(TagSessionEnablePassword)},
+  {"active", tag_servers_mqtt, 0, 0, 0, TAG_HANDLERS(TagServersMqttActive)},
+  {"service_name", tag_servers_mqtt, 0, 0, 0, TAG_HANDLERS(TagServersMqttServicename)},
+  {"host_name", tag_servers_mqtt, 0, 0, 0, TAG_HANDLERS(TagServersMqttHostname)},
+  {"address", tag_servers_mqtt, 0, 0, 0, TAG_HANDLERS(TagServersMqttAddress)},
+  {"port", tag_servers_mqtt, 0, 0, 0, TAG_HANDLERS(TagServersMqttPort)},
+  {"service_valid_until", tag_servers_mqtt, 0, 0, 0, TAG_HANDLERS(TagServersMqttServicevaliduntil)},
+  {"host_valid_until", tag_servers_mqtt, 0, 0, 0, TAG_HANDLERS(TagServersMqttHostvaliduntil)},
+  {"address_valid_until", tag_servers_mqtt, 0, 0, 0, TAG_HANDLERS(TagServersMqttAddressvaliduntil)},
+  {"success_counter", tag_servers_mqtt, 0, 0, 0, TAG_HANDLERS(TagServersMqttSuccesscounter)},
+  {"connection_attempts", tag_servers_mqtt, 0, 0, 0, TAG_HANDLERS(TagServersMqttConnectionattempts)},
+  {"filename", tag_fs_files, 0, 0, TAG_MEMOISE, TAG_HANDLERS(TagFsFilesFilename)},
+  {"size", tag_fs_files, 0, 0, TAG_MEMOISE, TAG_HANDLERS(TagFsFilesSize)},
+  {"is_mustache", tag_fs_files, 0, 0, TAG_MEMOISE, TAG_HANDLERS(TagFsFilesIsmustache)},
+  {"size", tag_fs_space, 0, 0, 0, TAG_HANDLERS(TagFsSpaceSize)},
+  {"used", tag_fs_space, 0, 0, 0, TAG_HANDLERS(TagFsSpaceUsed)},
+  {"remaining", tag_fs_space, 0, 0, 0, TAG_HANDLERS(TagFsSpaceRemaining)},
+  {"ratio_used", tag_fs_space, 0, 0, 0, TAG_HANDLERS(TagFsSpaceRatioused)},
+  {"ratio_remaining", tag_fs_space, 0, 0, 0, TAG_HANDLERS(TagFsSpaceRatioremaining)},
+  {"value", tag_io_iopin, 0, 0, 0, TAG_HANDLERS(TagUiIopinValue)},
+  {"selected", tag_io_iopin, 0, 0, 0, TAG_HANDLERS(TagUiIopinSelected)},
+  {"value", tag_io_iotype, 0, 0, 0, TAG_HANDLERS(TagUiIotypeValue)},
+  {"selected", tag_io_iotype, 0, 0, 0, TAG_HANDLERS(TagUiIotypeSelected)},
+  {"address", tag_host_mqtt_broker, 0, 0, TAG_CONFIGURABLE, TAG_HANDLERS(TagHostMqttBrokerAddress)},
+  {"port", tag_host_mqtt_broker, 0, 0, TAG_CONFIGURABLE, TAG_HANDLERS(TagHostMqttBrokerPort)},
+  {"depth", tag_host_mqtt_commands, 0, 0, 0, TAG_HANDLERS(TagHostMqttCommandsDepth)},
+  {"depth_max", tag_host_mqtt_commands, 0, 0, 0, TAG_HANDLERS(TagHostMqttCommandsDepthmax)},
+  {"drops", tag_host_mqtt_commands, 0, 0, 0, TAG_HANDLERS(TagHostMqttCommandsDrops)},
+  {"latency_ms", tag_host_mqtt_commands, 0, 0, 0, TAG_HANDLERS(TagHostMqttCommandsLatency)},
+  {"latency_max_ms", tag_host_mqtt_commands, 0, 0, 0, TAG_HANDLERS(TagHostMqttCommandsLatencymax)},
+  {"value", tag_session_enable_iopin, 0, 0, 0, TAG_HANDLERS(TagUiIopinValue)},
+  {"selected", tag_session_enable_iopin, 0, 0, 0, TAG_HANDLERS(TagUiIopinSelected)},
+};
+
+#define TAG_PATH_INDEX(child) \
+  {tag_nodes[child].parent, child, tagHash(tag_nodes[child].name, TAG_NAME_LEN)}
+
+// Sorted by parent then hash. Re-sort if a tag is added or renamed.
+constexpr Tag_Path_Index tag_path_index[TAG_COUNT -1] PROGMEM = {
+  TAG_PATH_INDEX(tag_mdns),
+  TAG_PATH_INDEX(tag_io),
+  TAG_PATH_INDEX(tag_fs),
+  TAG_PATH_INDEX(tag_sensors),
+  TAG_PATH_INDEX(tag_servers),
+  TAG_PATH_INDEX(tag_rules),
+  TAG_PATH_INDEX(tag_host),
+  TAG_PATH_INDEX(tag_session),
+  TAG_PATH_INDEX(tag_host_mqtt),
+  TAG_PATH_INDEX(tag_host_ssids),
+  TAG_PATH_INDEX(tag_host_hostname),
+  TAG_PATH_INDEX(tag_host_nw),
+  TAG_PATH_INDEX(tag_host_nwconfigured),
+  TAG_PATH_INDEX(tag_host_rssi),
+  TAG_PATH_INDEX(tag_host_http),
+  TAG_PATH_INDEX(tag_host_announce_suppressed),
+  TAG_PATH_INDEX(tag_host_core),
+  TAG_PATH_INDEX(tag_host_mac),
+  TAG_PATH_INDEX(tag_host_uptime),
+  TAG_PATH_INDEX(tag_session_validuntil),
+  TAG_PATH_INDEX(tag_session_overrideauth),
+  TAG_PATH_INDEX(tag_session_providedtoken),
+  TAG_PATH_INDEX(tag_session_valid),
+  TAG_PATH_INDEX(tag_session_expectedtoken),
+  TAG_PATH_INDEX(tag_session_enable),
+  TAG_PATH_INDEX(tag_servers_mqtt),
+  TAG_PATH_INDEX(tag_mdns_packet_count),
+  TAG_PATH_INDEX(tag_mdns_largest_packet),
+  TAG_PATH_INDEX(tag_mdns_success_rate),
+  TAG_PATH_INDEX(tag_mdns_buffer_success),
+  TAG_PATH_INDEX(tag_mdns_buffer_size),
+  TAG_PATH_INDEX(tag_fs_space),
+  TAG_PATH_INDEX(tag_fs_files),
+  TAG_PATH_INDEX(tag_io_suppressed),
+  TAG_PATH_INDEX(tag_io_index),
+  TAG_PATH_INDEX(tag_io_rate_limit),
+  TAG_PATH_INDEX(tag_io_iopin),
+  TAG_PATH_INDEX(tag_io_iotype),
+  TAG_PATH_INDEX(tag_io_state),
+  TAG_PATH_INDEX(tag_io_deadband),
+  TAG_PATH_INDEX(tag_io_default),
+  TAG_PATH_INDEX(tag_io_inverted),
+  TAG_PATH_INDEX(tag_io_topic),
+  TAG_PATH_INDEX(tag_io_interval),
+  TAG_PATH_INDEX(tag_io_iopin2),
+  TAG_PATH_INDEX(tag_io_sample_interval),
+  TAG_PATH_INDEX(tag_rules_duration),
+  TAG_PATH_INDEX(tag_rules_value),
+  TAG_PATH_INDEX(tag_rules_trigger),
+  TAG_PATH_INDEX(tag_rules_output),
+  TAG_PATH_INDEX(tag_rules_action),
+  TAG_PATH_INDEX(tag_rules_input),
+  TAG_PATH_INDEX(tag_sensors_budget_us),
+  TAG_PATH_INDEX(tag_sensors_overruns),
+  TAG_PATH_INDEX(tag_sensors_step_max_us),
+  TAG_PATH_INDEX(tag_host_core_core_version),
+  TAG_PATH_INDEX(tag_host_core_cpu_cycles),
+  TAG_PATH_INDEX(tag_host_core_flash_size),
+  TAG_PATH_INDEX(tag_host_core_cpu_speed),
+  TAG_PATH_INDEX(tag_host_core_memo_misses),
+  TAG_PATH_INDEX(tag_host_core_chip_id),
+  TAG_PATH_INDEX(tag_host_core_flash_free),
+  TAG_PATH_INDEX(tag_host_core_flash_speed),
+  TAG_PATH_INDEX(tag_host_core_memo_hits),
+  TAG_PATH_INDEX(tag_host_core_flash_ratio),
+  TAG_PATH_INDEX(tag_host_core_reset_reason),
+  TAG_PATH_INDEX(tag_host_core_ram_free),
+  TAG_PATH_INDEX(tag_host_core_sdk_version),
+  TAG_PATH_INDEX(tag_host_core_uptime),
+  TAG_PATH_INDEX(tag_host_nw_address),
+  TAG_PATH_INDEX(tag_host_nw_subnet),
+  TAG_PATH_INDEX(tag_host_nw_gateway),
+  TAG_PATH_INDEX(tag_host_nwconfigured_address),
+  TAG_PATH_INDEX(tag_host_nwconfigured_subnet),
+  TAG_PATH_INDEX(tag_host_nwconfigured_gateway),
+  TAG_PATH_INDEX(tag_host_ssids_name),
+  TAG_PATH_INDEX(tag_host_ssids_signal),
+  TAG_PATH_INDEX(tag_host_mqtt_subscribe_prefix),
+  TAG_PATH_INDEX(tag_host_mqtt_broker),
+  TAG_PATH_INDEX(tag_host_mqtt_solicit_window),
+  TAG_PATH_INDEX(tag_host_mqtt_publish_prefix),
+  TAG_PATH_INDEX(tag_host_mqtt_commands),
+  TAG_PATH_INDEX(tag_host_http_directory),
+  TAG_PATH_INDEX(tag_host_http_address),
+  TAG_PATH_INDEX(tag_host_http_port),
+  TAG_PATH_INDEX(tag_session_enable_password),
+  TAG_PATH_INDEX(tag_session_enable_iopin),
+  TAG_PATH_INDEX(tag_servers_mqtt_success_counter),
+  TAG_PATH_INDEX(tag_servers_mqtt_connection_attempts),
+  TAG_PATH_INDEX(tag_servers_mqtt_address),
+  TAG_PATH_INDEX(tag_servers_mqtt_host_name),
+  TAG_PATH_INDEX(tag_servers_mqtt_port),
+  TAG_PATH_INDEX(tag_servers_mqtt_address_valid_until),
+  TAG_PATH_INDEX(tag_servers_mqtt_service_valid_until),
+  TAG_PATH_INDEX(tag_servers_mqtt_host_valid_until),
+  TAG_PATH_INDEX(tag_servers_mqtt_active),
+  TAG_PATH_INDEX(tag_servers_mqtt_service_name),
+  TAG_PATH_INDEX(tag_fs_files_size),
+  TAG_PATH_INDEX(tag_fs_files_filename),
+  TAG_PATH_INDEX(tag_fs_files_is_mustache),
+  TAG_PATH_INDEX(tag_fs_space_remaining),
+  TAG_PATH_INDEX(tag_fs_space_size),
+  TAG_PATH_INDEX(tag_fs_space_ratio_remaining),
+  TAG_PATH_INDEX(tag_fs_space_used),
+  TAG_PATH_INDEX(tag_fs_space_ratio_used),
+  TAG_PATH_INDEX(tag_io_iopin_value),
+  TAG_PATH_INDEX(tag_io_iopin_selected),
+  TAG_PATH_INDEX(tag_io_iotype_value),
+  TAG_PATH_INDEX(tag_io_iotype_selected),
+  TAG_PATH_INDEX(tag_host_mqtt_broker_address),
+  TAG_PATH_INDEX(tag_host_mqtt_broker_port),
+  TAG_PATH_INDEX(tag_host_mqtt_commands_drops),
+  TAG_PATH_INDEX(tag_host_mqtt_commands_latency_max_ms),
+  TAG_PATH_INDEX(tag_host_mqtt_commands_depth_max),
+  TAG_PATH_INDEX(tag_host_mqtt_commands_latency_ms),
+  TAG_PATH_INDEX(tag_host_mqtt_commands_depth),
+  TAG_PATH_INDEX(tag_session_enable_iopin_value),
+  TAG_PATH_INDEX(tag_session_enable_iopin_selected),
+};
+
+// Each entry must lie within its parent's range of children and siblings must
+// be in ascending hash order.
+constexpr bool pathIndexSorted(const uint8_t i){
+  return i >= TAG_COUNT -1 ||
+      (i +1 >= tag_nodes[tag_path_index[i].parent].first_child &&
+       i +1 < tag_nodes[tag_path_index[i].parent].first_child +
+              tag_nodes[tag_path_index[i].parent].children_len &&
+       (i +1 >= TAG_COUNT -1 ||
+        tag_path_index[i].parent != tag_path_index[i +1].parent ||
+        tag_path_index[i].hash < tag_path_index[i +1].hash) &&
+       pathIndexSorted(i +1));
+}
+
+static_assert(pathIndexSorted(0), "tag_path_index is out of order.");
+
+static void touchBelow(TagBase& tag, const uint32_t generation){
+  tag.generation = generation;
+  for(uint8_t i = 0; i < tag.children_len(); i++){
+    touchBelow(*tag.getChild(i), generation);
+  }
+}
+
+void TagBase::touch(){
+  tag_generation++;
+  touchBelow(*this, tag_generation);
+  for(TagBase* t = getParent(); t != nullptr; t = t->getParent()){
+    t->generation = tag_generation;
+  }
+}
+
+void TagMemo::begin(){
+  if(depth++ > 0){
+    return;
+  }
+  // Anything cached before a tag changed, or too long ago to still be
+  // accurate for dynamic values, is dropped.
+  if(generation != tag_generation || millis() - filled_at > TAG_MEMO_TTL){
+    invalidate();
+    generation = tag_generation;
+    filled_at = millis();
+  }
+}
+
+void TagMemo::end(){
+  if(depth > 0){
+    depth--;
+  }
+}
+
+TagMemoEntry& TagMemo::slot(const uint32_t path_id, const uint8_t index){
+  return entries[((path_id * 2654435761UL) ^ index) % TAG_MEMO_LEN];
+}
+
+bool TagMemo::lookup(const uint32_t path_id, const uint8_t index,
+                     String& content, int& value, bool& result){
+  if(generation != tag_generation){
+    // A tag changed part way through a traversal.
+    invalidate();
+    generation = tag_generation;
+    filled_at = millis();
+  }
+  const TagMemoEntry& entry = slot(path_id, index);
+  if(entry.stamp != stamp || entry.path_id != path_id || entry.index != index){
+    misses++;
+    return false;
+  }
+  hits++;
+  content = entry.content;
+  value = entry.value;
+  result = entry.result;
+  return true;
+}
+
+void TagMemo::store(const uint32_t path_id, const uint8_t index,
+                    const String& content, const int value, const bool result){
+  TagMemoEntry& entry = slot(path_id, index);
+  entry.path_id = path_id;
+  entry.stamp = stamp;
+  entry.index = index;
+  entry.content = content;
+  entry.value = value;
+  entry.result = result;
+}
+
+// Tags whose value changes without contentsSave(), and how far the value may
+// drift before the tag counts as changed. A tag in a list is compared by the
+// total over every entry.
+// Sampled every TAG_SAMPLE_INTERVAL whether or not a client is listening, so
+// only tags that are cheap to read belong here. Not host.ssids; counting it
+// scans for WiFi networks.
+struct Tag_Dynamic {
+  uint8_t id;
+  uint16_t threshold;
+};
+
+constexpr Tag_Dynamic tag_dynamic[] PROGMEM = {
+  {tag_host_uptime, 60},
+  {tag_host_rssi, 5},
+  {tag_host_announce_suppressed, 0},
+  {tag_host_core_ram_free, 1024},
+  {tag_host_mqtt_commands_depth_max, 0},
+  {tag_host_mqtt_commands_drops, 0},
+  {tag_session_valid, 60},
+  {tag_servers_mqtt_success_counter, 0},
+  {tag_servers_mqtt_connection_attempts, 0},
+  {tag_mdns_packet_count, 10},
+  {tag_io_suppressed, 0},
+  {tag_sensors_overruns, 0},
+};
+
+#define TAG_DYNAMIC_COUNT (sizeof(tag_dynamic) / sizeof(tag_dynamic[0]))
+
+static int32_t tag_dynamic_sampled[TAG_DYNAMIC_COUNT];
+
+void sampleDynamicTags(){
+  static unsigned long sampled_at = 0;
+  if(millis() - sampled_at < TAG_SAMPLE_INTERVAL){
+    return;
+  }
+  sampled_at = millis();
+
+  for(uint8_t i = 0; i < TAG_DYNAMIC_COUNT; i++){
+    TagBase& tag = tags[pgm_read_byte(&tag_dynamic[i].id)];
+    const uint8_t entries = tag.getParent()->hasContents() ?
+                            tag.getParent()->contentCount() : 1;
+    int32_t total = 0;
+    for(uint8_t entry = 0; entry < entries; entry++){
+      String content;
+      int value = 0;
+      tag.sequence = entry;
+      tag.contentsAt(entry, content, value);
+      total += value;
+    }
+
+    const int32_t drift = total - tag_dynamic_sampled[i];
+    if(drift > (int32_t)pgm_read_word(&tag_dynamic[i].threshold) ||
+        -drift > (int32_t)pgm_read_word(&tag_dynamic[i].threshold)){
+      tag_dynamic_sampled[i] = total;
+      tag.touch();
+    }
+  }
+}
+
+void TaqQueue::dequeue(const uint32_t path_id, const uint32_t mask){
+  for(uint8_t i = 0; i < used; i++){
+    TagQueueEntry& entry = queue[(tail + i) % TAG_QUEUE_LEN];
+    if(entry.frame != TAG_ENTRY_DONE && ((entry.path_id ^ path_id) & mask) == 0){
+      Serial.print("TaqQueue::dequeue() ");
+      Serial.println(entry.path_id, HEX);
+
+      entry.frame = TAG_ENTRY_DONE;
+    }
+  }
+  advance();
+}
+
+void TaqQueue::ack(const uint32_t cumulative, const uint32_t sack){
+  for(uint32_t frame = base; frame < next_frame; frame++){
+    const uint32_t offset = frame - cumulative;
+    if(frame <= cumulative ||
+        (offset >= 2 && offset < 34 && (sack & (1UL << (offset -2))))){
+      ackFrame(frameRecord(frame), true);
+    }
+  }
+
+  // Rather than wait out the RTO, presume a frame lost once enough later
+  // frames have overtaken it. A frame already retransmitted waits for the RTO.
+  uint8_t acked_after = 0;
+  bool lost = false;
+  for(uint32_t frame = next_frame; frame-- > base;){
+    TagFrame& record = frameRecord(frame);
+    if(record.flags & TAG_FRAME_ACKED){
+      acked_after++;
+    } else if(acked_after >= TAG_DUP_THRESHOLD &&
+        !(record.flags & (TAG_FRAME_LOST | TAG_FRAME_RETRANSMITTED))){
+      record.flags |= TAG_FRAME_LOST;
+      lost = true;
+    }
+  }
+  if(lost){
+    window = (window > 1) ? window / 2 : 1;
+    window_acks = 0;
+  }
+
+  advance();
+}
+
+bool TaqQueue::sendFrame(std::function< void(String&, String&) > callback){
+  if(!callback){
+    return false;
+  }
+
+  for(uint32_t frame = base; frame < next_frame; frame++){
+    TagFrame& record = frameRecord(frame);
+    if(record.flags & TAG_FRAME_ACKED){
+      continue;
+    }
+    if(record.flags & TAG_FRAME_LOST){
+      record.flags &= ~TAG_FRAME_LOST;
+    } else if(millis() - record.sent_at >= rto){
+      rto = (rto * 2 < TAG_RTO_MAX) ? rto * 2 : TAG_RTO_MAX;
+      window = 1;
+      window_acks = 0;
+    } else {
+      continue;
+    }
+    record.flags |= TAG_FRAME_RETRANSMITTED;
+    String payload;
+    if(render(record, payload)){
+      transmit(record, payload, callback);
+      return true;
+    }
+    // Every entry in the frame was dequeued since it was sent.
+    ackFrame(record, false);
+  }
+  advance();
+
+  if(next_frame - base >= window || sent == used){
+    return false;
+  }
+
+  TagFrame& record = frameRecord(next_frame);
+  record.frame = next_frame;
+  record.start = (tail + sent) % TAG_QUEUE_LEN;
+  record.len = used - sent;
+  record.flags = 0;
+  String payload;
+  const bool rendered = render(record, payload);
+  sent += record.len;
+  if(!rendered){
+    // None of the entries had anything to send.
+    advance();
+    return false;
+  }
+  // Before sending, in case the ack arrives before the callback returns.
+  next_frame++;
+  transmit(record, payload, callback);
+  return true;
+}
+
+void TaqQueue::ackFrame(TagFrame& record, const bool sample){
+  if(record.flags & TAG_FRAME_ACKED){
+    return;
+  }
+  record.flags |= TAG_FRAME_ACKED;
+
+  for(uint8_t i = 0; i < record.len; i++){
+    TagQueueEntry& entry = queue[(record.start + i) % TAG_QUEUE_LEN];
+    if(entry.frame == record.frame){
+      entry.frame = TAG_ENTRY_DONE;
+    }
+  }
+
+  if(!sample){
+    return;
+  }
+  if(!(record.flags & TAG_FRAME_RETRANSMITTED)){
+    rttSample(millis() - record.sent_at);
+  }
+  if(++window_acks >= window){
+    window_acks = 0;
+    if(window < TAG_WINDOW_MAX){
+      window++;
+    }
+  }
+}
+
+// Jacobson/Karels, as TCP. (RFC 6298)
+void TaqQueue::rttSample(const uint32_t rtt){
+  if(srtt == 0){
+    srtt = rtt;
+    rttvar = rtt / 2;
+  } else {
+    const uint32_t delta = (srtt > rtt) ? srtt - rtt : rtt - srtt;
+    rttvar = (3 * rttvar + delta) / 4;
+    srtt = (7 * srtt + rtt) / 8;
+  }
+  if(srtt == 0){
+    // Still counts as sampled.
+    srtt = 1;
+  }
+  rto = constrain(srtt + 4 * rttvar, (uint32_t)TAG_RTO_MIN, (uint32_t)TAG_RTO_MAX);
+}
+
+// Forget acknowledged frames and entries at the back of the window.
+void TaqQueue::advance(){
+  while(base < next_frame && (frameRecord(base).flags & TAG_FRAME_ACKED)){
+    base++;
+  }
+  while(used > 0 && queue[tail].frame == TAG_ENTRY_DONE){
+    tail = (tail +1) % TAG_QUEUE_LEN;
+    used--;
+    if(sent > 0){
+      sent--;
+    }
+  }
+}
+
+// Render the entries of record into a "teach_frame".
+// A new frame claims unsent entries until TAG_FRAME_LEN is reached, shortening
+// record.len to match.
+// Returns false if no entry had anything to send.
+bool TaqQueue::render(TagFrame& record, String& frame){
+  frame.reserve(TAG_FRAME_LEN);
+  frame = "{\"_command\":\"teach_frame\",\"frame\":";
+  frame += record.frame;
+  frame += ",\"base\":";
+  frame += base;
+  if(session != 0){
+    frame += ",\"session\":";
+    frame += session;
+  }
+  frame += ",\"tags\":[";
+
+  uint8_t records = 0;
+  uint8_t i = 0;
+  for(; i < record.len; i++){
+    TagQueueEntry& entry = queue[(record.start + i) % TAG_QUEUE_LEN];
+    if(entry.frame != record.frame && entry.frame != TAG_ENTRY_UNSENT){
+      continue;
+    }
+    String tag_record;
+    if(!tagByPathId(entry.path_id)->teachRecord(tag_record)){
+      // Tag does not need sending.
+      entry.frame = TAG_ENTRY_DONE;
+      continue;
+    }
+    if(entry.frame == TAG_ENTRY_UNSENT && records > 0 &&
+        frame.length() + tag_record.length() +3 > TAG_FRAME_LEN){
+      break;
+    }
+    if(records > 0){
+      frame += ",";
+    }
+    frame += tag_record;
+    entry.frame = record.frame;
+    records++;
+  }
+  record.len = i;
+
+  if(records == 0){
+    return false;
+  }
+  frame += "]}";
+  return true;
+}
+
+void TaqQueue::transmit(TagFrame& record, String& frame,
+                        std::function< void(String&, String&) > callback){
+  Serial.print("TaqQueue::transmit() ");
+  Serial.print(record.frame);
+  Serial.print(" rto: ");
+  Serial.println(rto);
+
+  record.sent_at = millis();
+  String topic = "";
+  callback(topic, frame);
+}
+
+bool TagSyncSession::loop(){
+  if(millis() - heard_at > TAG_SYNC_TIMEOUT){
+    Serial.print("TagSyncSession::loop() Timed out: ");
+    Serial.println(id);
+    stop();
+    return false;
+  }
+
+  TagMemoScope memo;
+
+  // Fill the queue so frames go out as full as possible.
+  while(!queue.full()){
+    TagBase* tag = itterator.loop();
+    if(tag == nullptr){
+      break;
+    }
+    queue.push(tag);
+  }
+  if(queue.sendFrame(callback)){
+    return true;
+  }
+
+  if(itterator.done() && queue.empty()){
+    // Everything has been acknowledged. A "learn_since" from this generation
+    // picks up where this pass started.
+    String topic = "";
+    String payload = "{\"_command\":\"teach_done\",\"session\":";
+    payload += id;
+    payload += ",\"since\":";
+    payload += itterator.sinceGeneration();
+    payload += ",\"generation\":";
+    payload += itterator.startGeneration();
+    payload += ",\"epoch\":";
+    payload += tag_epoch;
+    payload += "}";
+    callback(topic, payload);
+    stop();
+    return true;
+  }
+  return false;
+}
+
+static TagSyncSession sync_sessions[TAG_SYNC_SESSIONS];
+static uint32_t sync_session_last_id = 0;
+static uint8_t sync_session_next = 0;
+
+void tagSyncStart(const uint32_t since, const Transport transport,
+                  std::function< void(String&, String&) > callback){
+  TagSyncSession* session = &sync_sessions[transport];
+  if(session->active()){
+    Serial.print("tagSyncStart() Replacing: ");
+    Serial.println(session->id);
+  }
+  if(++sync_session_last_id == 0){
+    sync_session_last_id = 1;
+  }
+  // Each pass computes every value afresh.
+  tag_memo.invalidate();
+  session->start(sync_session_last_id, since, callback);
+}
+
+void tagSyncAck(const uint32_t session, const uint32_t cumulative, const uint32_t sack){
+  for(uint8_t i = 0; i < TAG_SYNC_SESSIONS; i++){
+    if(sync_sessions[i].active() && sync_sessions[i].id == session){
+      sync_sessions[i].ack(cumulative, sack);
+    }
+  }
+}
+
+void tagSyncDequeue(const uint32_t path_id, const uint32_t mask){
+  for(uint8_t i = 0; i < TAG_SYNC_SESSIONS; i++){
+    if(sync_sessions[i].active()){
+      sync_sessions[i].dequeue(path_id, mask);
+    }
+  }
+}
+
+void tagSyncLoop(){
+  for(uint8_t i = 0; i < TAG_SYNC_SESSIONS; i++){
+    TagSyncSession& session = sync_sessions[sync_session_next];
+    sync_session_next = (sync_session_next +1) % TAG_SYNC_SESSIONS;
+    if(session.active() && session.loop()){
+      return;
+    }
+  }
+}
+
+static TagSubscription subscriptions[TAG_SUBSCRIPTIONS];
+
+static TagSubscription* findSubscription(const char* pattern, const Transport transport){
+  for(uint8_t i = 0; i < TAG_SUBSCRIPTIONS; i++){
+    if(subscriptions[i].pattern[0] != '\0' && subscriptions[i].transport == transport &&
+        strcmp(subscriptions[i].pattern, pattern) == 0){
+      return &subscriptions[i];
+    }
+  }
+  return nullptr;
+}
+
+bool tagSubscribe(const char* pattern, const uint16_t interval, const Transport transport,
+                  std::function< void(String&, String&) > callback){
+  if(*pattern == '\0' || strlen(pattern) >= TAG_PATH_LEN){
+    return false;
+  }
+
+  TagSubscription* subscription = findSubscription(pattern, transport);
+  if(subscription == nullptr){
+    uint8_t used = 0;
+    for(uint8_t i = 0; i < TAG_SUBSCRIPTIONS; i++){
+      if(subscriptions[i].pattern[0] == '\0'){
+        if(subscription == nullptr){
+          subscription = &subscriptions[i];
+        }
+      } else if(subscriptions[i].transport == transport){
+        used++;
+      }
+    }
+    if(used >= TAG_SUBSCRIPTIONS_PER_TRANSPORT){
+      subscription = nullptr;
+    }
+  }
+  if(subscription == nullptr){
+    Serial.print("tagSubscribe() No room for ");
+    Serial.println(pattern);
+    return false;
+  }
+
+  if(subscription->pattern[0] == '\0'){
+    strncpy(subscription->pattern, pattern, TAG_PATH_LEN);
+    subscription->transport = transport;
+    subscription->generation = 0;
+    subscription->pushed_at = millis() - interval;
+    subscription->pushing = false;
+  }
+  subscription->interval = interval;
+  subscription->renewed_at = millis();
+  subscription->callback = callback;
+  return true;
+}
+
+void tagUnsubscribe(const char* pattern, const Transport transport){
+  TagSubscription* subscription = findSubscription(pattern, transport);
+  if(subscription != nullptr){
+    subscription->pattern[0] = '\0';
+    subscription->callback = nullptr;
+  }
+}
+
+static void sendNotify(TagSubscription& subscription, String& payload){
+  payload += "]}";
+  String topic = "";
+  subscription.callback(topic, payload);
+}
+
+// Append the record for tag to payload, starting a "notify" if it is empty.
+// Returns false, leaving payload alone, if the record would not fit.
+static bool addNotifyRecord(const TagSubscription& subscription, TagBase* tag,
+                            String& payload){
+  String record;
+  if(!tag->teachRecord(record)){
+    return true;
+  }
+  if(payload.length() > 0 && payload.length() + record.length() +3 > TAG_FRAME_LEN){
+    return false;
+  }
+  if(payload.length() == 0){
+    payload = "{\"_command\":\"notify\",\"generation\":";
+    payload += subscription.itterator.startGeneration();
+    payload += ",\"tags\":[";
+  } else {
+    payload += ",";
+  }
+  payload += record;
+  return true;
+}
+
+// Send the next "notify" of subscription's push, starting one if needed.
+// A large push is spread over several calls so loop() is not held up.
+static void pushSubscription(TagSubscription& subscription){
+  TagItterator& itterator = subscription.itterator;
+  if(!subscription.pushing){
+    // Only the branches changed since the last push, and which could match
+    // the pattern, are walked.
+    itterator.reset(subscription.generation, subscription.pattern);
+    subscription.pushing = true;
+    subscription.held_path_id = 0;
+  }
+
+  TagMemoScope memo;
+  String payload;
+  if(subscription.held_path_id != 0){
+    TagBase* held = tagByPathId(subscription.held_path_id);
+    subscription.held_path_id = 0;
+    if(held != nullptr){
+      addNotifyRecord(subscription, held, payload);
+    }
+  }
+
+  TagBase* tag;
+  while((tag = itterator.loop()) != nullptr){
+    if(!addNotifyRecord(subscription, tag, payload)){
+      subscription.held_path_id = tag->pathId();
+      break;
+    }
+  }
+  if(payload.length() > 0){
+    sendNotify(subscription, payload);
+  }
+
+  if(subscription.held_path_id == 0 && itterator.done()){
+    subscription.pushing = false;
+    subscription.generation = itterator.startGeneration();
+    subscription.pushed_at = millis();
+  }
+}
+
+void pushSubscriptions(){
+  for(uint8_t i = 0; i < TAG_SUBSCRIPTIONS; i++){
+    TagSubscription& subscription = subscriptions[i];
+    if(subscription.pattern[0] == '\0'){
+      continue;
+    }
+    if(millis() - subscription.renewed_at > TAG_SUBSCRIBE_TTL){
+      Serial.print("pushSubscriptions() Lapsed: ");
+      Serial.println(subscription.pattern);
+      tagUnsubscribe(subscription.pattern, subscription.transport);
+      continue;
+    }
+    if(!subscription.pushing &&
+        (millis() - subscription.pushed_at < subscription.interval ||
+         tag_generation <= subscription.generation)){
+      continue;
+    }
+    pushSubscription(subscription);
+  }
+}
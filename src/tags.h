@@ -36,76 +36,320 @@
 
 #define MAX_TAG_RECURSION 10
 
+// Longest tag name, including the terminating NUL.
+#define TAG_NAME_LEN 20
+
+// Longest path returned by TagBase::getPath(), including the terminating NUL.
+#define TAG_PATH_LEN 64
+
 #define COMMON_DEF Config* _config, MdnsLookup* _brokers, mdns::MDns* _mdns, Mqtt* _mqtt, Io* _io
 
-#define COMMON_PERAMS _config, _brokers, _mdns, _mqtt, _io
+// Tag_Node::flags
+#define TAG_CONFIGURABLE 0x01
+#define TAG_DIRECT_VALUE 0x02
+#define TAG_MEMOISE 0x04       // contentsAt() is worth caching during a traversal.
+
+#define TAG_HANDLERS(handler) &handler::contentsAt, &handler::contentsSave, &handler::contentCount
+
+// FNV-1a hash of the first len characters of a tag name.
+// constexpr so tag_path_index can be checked at compile time.
+constexpr uint32_t tagHash(const char* name, const size_t len, const uint32_t hash = 2166136261UL){
+  return (len == 0 || *name == '\0') ? hash :
+      tagHash(name +1, len -1, (uint32_t)((hash ^ (uint8_t)*name) * 16777619UL));
+}
+
+
+// Every tag in the tree, in the order they appear in tag_nodes.
+// The children of a tag are always consecutive.
+enum Tag_Id : uint8_t {
+  tag_root,
+  tag_host,
+  tag_session,
+  tag_servers,
+  tag_mdns,
+  tag_fs,
+  tag_io,
+  tag_rules,
+  tag_sensors,
+  tag_host_hostname,
+  tag_host_mac,
+  tag_host_uptime,
+  tag_host_rssi,
+  tag_host_core,
+  tag_host_nw,
+  tag_host_nwconfigured,
+  tag_host_ssids,
+  tag_host_mqtt,
+  tag_host_http,
+  tag_host_announce_suppressed,
+  tag_session_valid,
+  tag_session_validuntil,
+  tag_session_providedtoken,
+  tag_session_expectedtoken,
+  tag_session_overrideauth,
+  tag_session_enable,
+  tag_servers_mqtt,
+  tag_mdns_buffer_success,
+  tag_mdns_packet_count,
+  tag_mdns_success_rate,
+  tag_mdns_largest_packet,
+  tag_mdns_buffer_size,
+  tag_fs_files,
+  tag_fs_space,
+  tag_io_index,
+  tag_io_topic,
+  tag_io_inverted,
+  tag_io_default,
+  tag_io_iopin,
+  tag_io_iotype,
+  tag_io_sample_interval,
+  tag_io_interval,
+  tag_io_deadband,
+  tag_io_iopin2,
+  tag_io_rate_limit,
+  tag_io_suppressed,
+  tag_io_state,
+  tag_rules_input,
+  tag_rules_output,
+  tag_rules_trigger,
+  tag_rules_action,
+  tag_rules_value,
+  tag_rules_duration,
+  tag_sensors_step_max_us,
+  tag_sensors_overruns,
+  tag_sensors_budget_us,
+  tag_host_core_cpu_speed,
+  tag_host_core_flash_size,
+  tag_host_core_flash_free,
+  tag_host_core_flash_ratio,
+  tag_host_core_flash_speed,
+  tag_host_core_ram_free,
+  tag_host_core_sdk_version,
+  tag_host_core_core_version,
+  tag_host_core_reset_reason,
+  tag_host_core_chip_id,
+  tag_host_core_cpu_cycles,
+  tag_host_core_uptime,
+  tag_host_core_memo_hits,
+  tag_host_core_memo_misses,
+  tag_host_nw_address,
+  tag_host_nw_gateway,
+  tag_host_nw_subnet,
+  tag_host_nwconfigured_address,
+  tag_host_nwconfigured_gateway,
+  tag_host_nwconfigured_subnet,
+  tag_host_ssids_name,
+  tag_host_ssids_signal,
+  tag_host_mqtt_broker,
+  tag_host_mqtt_subscribe_prefix,
+  tag_host_mqtt_publish_prefix,
+  tag_host_mqtt_solicit_window,
+  tag_host_mqtt_commands,
+  tag_host_http_address,
+  tag_host_http_port,
+  tag_host_http_directory,
+  tag_session_enable_iopin,
+  tag_session_enable_password,
+  tag_servers_mqtt_active,
+  tag_servers_mqtt_service_name,
+  tag_servers_mqtt_host_name,
+  tag_servers_mqtt_address,
+  tag_servers_mqtt_port,
+  tag_servers_mqtt_service_valid_until,
+  tag_servers_mqtt_host_valid_until,
+  tag_servers_mqtt_address_valid_until,
+  tag_servers_mqtt_success_counter,
+  tag_servers_mqtt_connection_attempts,
+  tag_fs_files_filename,
+  tag_fs_files_size,
+  tag_fs_files_is_mustache,
+  tag_fs_space_size,
+  tag_fs_space_used,
+  tag_fs_space_remaining,
+  tag_fs_space_ratio_used,
+  tag_fs_space_ratio_remaining,
+  tag_io_iopin_value,
+  tag_io_iopin_selected,
+  tag_io_iotype_value,
+  tag_io_iotype_selected,
+  tag_host_mqtt_broker_address,
+  tag_host_mqtt_broker_port,
+  tag_host_mqtt_commands_depth,
+  tag_host_mqtt_commands_depth_max,
+  tag_host_mqtt_commands_drops,
+  tag_host_mqtt_commands_latency_ms,
+  tag_host_mqtt_commands_latency_max_ms,
+  tag_session_enable_iopin_value,
+  tag_session_enable_iopin_selected,
+  TAG_COUNT
+};
+
+class TagBase;
+
+// The fixed structure of one tag.
+// Lives in flash so must be read with pgm_read_*() or memcpy_P().
+struct Tag_Node {
+  char name[TAG_NAME_LEN];
+  uint8_t parent;
+  uint8_t first_child;
+  uint8_t children_len;
+  uint8_t flags;
+  bool (*contents_at)(TagBase& tag, uint8_t index, String& content, int& value);
+  bool (*contents_save)(TagBase& tag, const String& content);
+  uint8_t (*content_count)(TagBase& tag);
+};
+
+extern const Tag_Node tag_nodes[TAG_COUNT] PROGMEM;
+
+// The children of every tag sorted by the hash of their name, so a child can
+// be found by name with a binary search.
+// Entries are in the same order as the children in tag_nodes so the children
+// of a tag start at tag_path_index[first_child -1].
+struct Tag_Path_Index {
+  uint8_t parent;
+  uint8_t id;
+  uint32_t hash;
+};
+
+extern const Tag_Path_Index tag_path_index[TAG_COUNT -1] PROGMEM;
+
+
+#define TAG_MEMO_LEN 16
+#define TAG_MEMO_TTL 1000   // Milliseconds before a cached value is recomputed.
+#define TAG_MEMO_COUNT 0xFF // TagMemoEntry::index of a cached contentCount().
+
+struct TagMemoEntry {
+  uint32_t path_id;
+  uint32_t stamp;     // TagMemo::stamp when stored. Stale if different.
+  uint8_t index;
+  bool result;
+  int value;
+  String content;
+};
+
+// Values computed during a traversal of the tags.
+// Lists are counted, and siblings looked up, many times per tag during a
+// walk. Within a TagMemoScope each is computed once then served from here.
+// Keyed by TagBase::pathId() so the same tag in different list entries is
+// cached separately.
+class TagMemo{
+ public:
+  TagMemo() : hits(0), misses(0), stamp(1), depth(0), generation(0), filled_at(0) {}
+
+  // Start or finish a traversal. May be nested.
+  void begin();
+  void end();
+  bool active() const { return depth > 0; }
+
+  // Forget everything. Called when a new sync pass starts.
+  void invalidate(){ stamp++; }
+
+  bool lookup(const uint32_t path_id, const uint8_t index,
+              String& content, int& value, bool& result);
+  void store(const uint32_t path_id, const uint8_t index,
+             const String& content, const int value, const bool result);
+
+  uint32_t hits;
+  uint32_t misses;
+ private:
+  TagMemoEntry& slot(const uint32_t path_id, const uint8_t index);
+
+  TagMemoEntry entries[TAG_MEMO_LEN];
+  uint32_t stamp;
+  uint8_t depth;
+  uint32_t generation;      // tag_generation when filling started.
+  unsigned long filled_at;
+};
 
-#define COMMON_ALLOCATE config(_config), brokers(_brokers), mdns(_mdns), mqtt(_mqtt), io(_io), base_children(_base_children), parent(NULL), children_len(_children_len), id(0)
+extern TagMemo tag_memo;
 
-#define CHILDREN_LEN (sizeof(children)/sizeof(children[0]))
+// Caches values in tag_memo for as long as it is in scope.
+class TagMemoScope{
+ public:
+  TagMemoScope(){ tag_memo.begin(); }
+  ~TagMemoScope(){ tag_memo.end(); }
+};
 
 
+// The part of a tag that changes at runtime.
+// One per entry in tag_nodes. Everything else is looked up in flash by id().
 class TagBase{
  public:
-  TagBase(TagBase** _base_children, const uint8_t _children_len,
-          COMMON_DEF, const char* _name) : COMMON_ALLOCATE, name(_name)
-  {
-    id = id_counter++;
+  uint8_t id() const;
+
+  const __FlashStringHelper* name() const {
+    return FPSTR(tag_nodes[id()].name);
   }
 
-  virtual bool contentsAt(uint8_t /*index*/, String& content, int& value){
-    content = "";
-    value = 0;
-    return false;
+  uint8_t children_len() const {
+    return pgm_read_byte(&tag_nodes[id()].children_len);
   }
 
-  virtual bool contentsSave(const String& /*content*/){
-    configurable = false;
-    direct_value = false;
-    return false;
+  bool configurable() const {
+    return pgm_read_byte(&tag_nodes[id()].flags) & TAG_CONFIGURABLE;
   }
 
-  virtual uint8_t contentCount(){
-    return 0;
+  bool direct_value() const {
+    return pgm_read_byte(&tag_nodes[id()].flags) & TAG_DIRECT_VALUE;
+  }
+
+  bool memoise() const {
+    return pgm_read_byte(&tag_nodes[id()].flags) & TAG_MEMOISE;
   }
 
-  TagBase* matchPath(const String* name_list, uint8_t list_pointer=0) {
-    if(strcmp(name, name_list[list_pointer].c_str()) == 0 || list_pointer >= MAX_TAG_RECURSION){
-      return parent;
+  bool contentsAt(uint8_t index, String& content, int& value){
+    const bool memo = tag_memo.active() && memoise();
+    bool result;
+    if(memo && tag_memo.lookup(pathId(), index, content, value, result)){
+      return result;
     }
-    for(uint8_t child = 0; child < children_len; child++){
-      return matchPath(name_list, list_pointer +1);
+    bool (*handler)(TagBase&, uint8_t, String&, int&);
+    memcpy_P(&handler, &tag_nodes[id()].contents_at, sizeof(handler));
+    result = handler(*this, index, content, value);
+    if(memo){
+      tag_memo.store(pathId(), index, content, value, result);
     }
-    return this;
+    return result;
   }
 
-  TagBase* getChild(uint8_t index){
-    if(index > children_len){
-      return nullptr;
+  bool contentsSave(const String& content){
+    bool (*handler)(TagBase&, const String&);
+    memcpy_P(&handler, &tag_nodes[id()].contents_save, sizeof(handler));
+    if(!handler(*this, content)){
+      return false;
     }
-    base_children[index]->parent = this;
-    return base_children[index];
+    touch();
+    return true;
   }
 
-  TagBase* getParent(){
-    return parent;
-  }
+  // Cached in tag_memo while it is active.
+  uint8_t contentCount();
 
-  String getPath(){
-    String path = name;
-    TagBase* p = parent;
-    if(p && strcmp(p->name, "root") != 0){
-      if(p->contentCount() > 0){
-        path = "." + path;
-        path = sequence + path;
-      };
-      path = p->getPath() + "." + path;
-    }
+  TagBase* getChild(uint8_t index);
 
-    return path;
-  }
+  // Child with the name in the first len characters of name_, or nullptr.
+  TagBase* findChild(const char* name_, const uint8_t len);
+
+  TagBase* getParent();
+
+  // Whether this tag has a contentCount() handler, making its children lists.
+  bool hasContents() const;
+
+  // Compact alternative to getPath(). id() in the low byte, then the sequence
+  // of each tag on the path whose parent is a list, innermost first.
+  uint32_t pathId();
+
+  // Rendered straight from tag_nodes in one pass. No recursion and no
+  // contentCount() calls.
+  String getPath();
+
+  // Mark this tag, everything below it and every tag above it as changed in
+  // a new tag_generation.
+  void touch();
     
-  bool sendData(std::function< void(String&, String&) > callback){
+  // Render this tag as the JSON body of a "teach". If command is set it is
+  // included as "_command". False if the tag has no content to send.
+  bool teachRecord(String& record, const char* command=nullptr){
     String content;
     int value;
     contentsAt(sequence, content, value);
@@ -122,107 +366,270 @@ class TagBase{
     StaticJsonBuffer<300> jsonBuffer;
     JsonObject& root = jsonBuffer.createObject();
     root["name"] = getPath();
-    root["id"] = id;
-    root["_command"] = "teach";
+    root["id"] = id();
+    if(command != nullptr){
+      root["_command"] = command;
+    }
     root["content"] = content;
     root["value"] = value;
     root["sequence"] = sequence;
-    if(parent){
-      root["total"] = parent->contentCount();
+    root["path_id"] = pathId();
+    if(id() != tag_root){
+      root["total"] = getParent()->contentCount();
     }
 
+    root.printTo(record);
+    return true;
+  }
+
+  bool sendData(std::function< void(String&, String&) > callback){
     String host_topic = "";
     String host_payload = "";
-    root.printTo(host_payload);
+    if(!teachRecord(host_payload, "teach")){
+      return false;
+    }
 
     callback(host_topic, host_payload);
 
     return true;
   }
 
- protected:
-  Config* config;
-  MdnsLookup* brokers;
-  mdns::MDns* mdns;
-  Mqtt* mqtt;
-  Io* io;
-  TagBase** base_children;
-  TagBase* parent;
- public:
-  const uint8_t children_len;
-  uint16_t id;
-  const char* name;
+  uint32_t generation;  // tag_generation when this tag, or one below it, last changed.
   uint8_t sequence;
-  bool configurable;
-  bool direct_value;
-  static uint16_t id_counter;
 };
 
+extern TagBase tags[TAG_COUNT];
+
+// Incremented whenever any tag changes. "learn_since" sends only the tags
+// changed after a given generation.
+extern uint32_t tag_generation;
+// Random at boot so a generation from before a restart is never trusted.
+extern uint32_t tag_epoch;
+
+#define TAG_SAMPLE_INTERVAL 1000
+
+// Touch any tag whose value has drifted without contentsSave() since it was
+// last touched. Call from loop(). Samples at most every TAG_SAMPLE_INTERVAL.
+void sampleDynamicTags();
+
+inline uint8_t TagBase::id() const {
+  return this - tags;
+}
+
+inline TagBase* TagBase::getChild(uint8_t index){
+  if(index >= children_len()){
+    return nullptr;
+  }
+  return &tags[pgm_read_byte(&tag_nodes[id()].first_child) + index];
+}
+
+inline TagBase* TagBase::findChild(const char* name_, const uint8_t len){
+  if(len >= TAG_NAME_LEN){
+    return nullptr;
+  }
+  const uint32_t hash = tagHash(name_, len);
+  const uint8_t children = children_len();
+  int16_t low = pgm_read_byte(&tag_nodes[id()].first_child) -1;
+  int16_t high = low + children -1;
+  while(children > 0 && low <= high){
+    const int16_t middle = (low + high) / 2;
+    const uint32_t middle_hash = pgm_read_dword(&tag_path_index[middle].hash);
+    if(middle_hash < hash){
+      low = middle +1;
+    } else if(middle_hash > hash){
+      high = middle -1;
+    } else {
+      const uint8_t child = pgm_read_byte(&tag_path_index[middle].id);
+      if(strncmp_P(name_, tag_nodes[child].name, len) == 0 &&
+          pgm_read_byte(&tag_nodes[child].name[len]) == '\0'){
+        return &tags[child];
+      }
+      return nullptr;
+    }
+  }
+  return nullptr;
+}
+
+inline TagBase* TagBase::getParent(){
+  if(id() == tag_root){
+    return nullptr;
+  }
+  return &tags[pgm_read_byte(&tag_nodes[id()].parent)];
+}
+
 
-class TagUiIopinValue : public TagBase{
+// Context shared by every tag handler. Set once by setContext().
+// A handler implements any of contentsAt(), contentsSave() and contentCount();
+// the rest fall back to these defaults.
+class TagHandler{
  public:
-  TagUiIopinValue(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "value"),
-                        children{
-                        } {}
-  TagBase* children[0];
-  
-  int values[11] = {0,1,2,3,4,5,12,13,14,15,16};  // Valid output pins.
+  static void setContext(COMMON_DEF){
+    config = _config;
+    brokers = _brokers;
+    mdns = _mdns;
+    mqtt = _mqtt;
+    io = _io;
+  }
 
-  bool contentsAt(uint8_t index, String& content, int& value){
-    value = values[index];
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
+    content = "";
+    value = 0;
+    return false;
+  }
+
+  static bool contentsSave(TagBase& /*tag*/, const String& /*content*/){
+    return false;
+  }
+
+  static uint8_t contentCount(TagBase& /*tag*/){
+    return 0;
+  }
+
+ protected:
+  static Config* config;
+  static MdnsLookup* brokers;
+  static mdns::MDns* mdns;
+  static Mqtt* mqtt;
+  static Io* io;
+};
+
+inline bool TagBase::hasContents() const {
+  uint8_t (*handler)(TagBase&);
+  memcpy_P(&handler, &tag_nodes[id()].content_count, sizeof(handler));
+  return handler != &TagHandler::contentCount;
+}
+
+inline uint8_t TagBase::contentCount(){
+  uint8_t (*handler)(TagBase&);
+  memcpy_P(&handler, &tag_nodes[id()].content_count, sizeof(handler));
+  if(handler == &TagHandler::contentCount || !tag_memo.active()){
+    return handler(*this);
+  }
+  String content;
+  int value;
+  bool result;
+  if(tag_memo.lookup(pathId(), TAG_MEMO_COUNT, content, value, result)){
+    return value;
+  }
+  value = handler(*this);
+  tag_memo.store(pathId(), TAG_MEMO_COUNT, content, value, false);
+  return value;
+}
+
+inline String TagBase::getPath(){
+  uint8_t chain[MAX_TAG_RECURSION];
+  uint8_t depth = 0;
+  for(TagBase* t = this; t->id() != tag_root && depth < MAX_TAG_RECURSION;
+      t = t->getParent()){
+    chain[depth++] = t->id();
+  }
+
+  char path[TAG_PATH_LEN];
+  size_t len = 0;
+  path[0] = '\0';
+  while(depth-- > 0 && len < TAG_PATH_LEN -1){
+    TagBase& t = tags[chain[depth]];
+    if(t.getParent()->hasContents()){
+      len += snprintf(path + len, TAG_PATH_LEN - len, "%u.", t.sequence);
+    }
+    if(len < TAG_PATH_LEN -1){
+      strncpy_P(path + len, tag_nodes[t.id()].name, TAG_PATH_LEN - len -1);
+      path[TAG_PATH_LEN -1] = '\0';
+      len += strlen(path + len);
+    }
+    if(depth > 0 && len < TAG_PATH_LEN -1){
+      path[len++] = '.';
+      path[len] = '\0';
+    }
+  }
+  return String(path);
+}
+
+inline uint32_t TagBase::pathId(){
+  uint32_t path_id = id();
+  uint8_t shift = 8;
+  for(TagBase* t = this; t->id() != tag_root && shift < 32; t = t->getParent()){
+    if(t->getParent()->hasContents()){
+      path_id |= (uint32_t)t->sequence << shift;
+      shift += 8;
+    }
+  }
+  return path_id;
+}
+
+// Inverse of TagBase::pathId(). Sets the sequence of every list entry on the
+// path. nullptr if path_id does not name a tag.
+inline TagBase* tagByPathId(const uint32_t path_id){
+  if((path_id & 0xFF) >= TAG_COUNT){
+    return nullptr;
+  }
+  TagBase* target = &tags[path_id & 0xFF];
+  target->sequence = 0;
+  uint8_t shift = 8;
+  for(TagBase* t = target; t->id() != tag_root; t = t->getParent()){
+    if(t->getParent()->hasContents()){
+      t->sequence = (shift < 32) ? (path_id >> shift) & 0xFF : 0;
+      shift += 8;
+    }
+  }
+  return target;
+}
+
+
+// Valid output pins, followed by any IO expander pins.
+const int ui_iopins[] = {0,1,2,3,4,5,12,13,14,15,16};
+const uint8_t UI_IOPIN_COUNT = sizeof(ui_iopins) / sizeof(ui_iopins[0]) +
+    (EXPANDER_TYPE == EXPANDER_NONE ? 0 : EXPANDER_PINS);
+
+inline int uiIopin(const uint8_t index){
+  const uint8_t physical = sizeof(ui_iopins) / sizeof(ui_iopins[0]);
+  if(index < physical){
+    return ui_iopins[index];
+  }
+  return EXPANDER_PIN_BASE + index - physical;
+}
+
+class TagUiIopinValue : public TagHandler{
+ public:
+  static bool contentsAt(TagBase& /*tag*/, uint8_t index, String& content, int& value){
+    value = uiIopin(index);
     content = value;
-    return (index < 10);
+    return (index < UI_IOPIN_COUNT -1);
   }
 };
 
-class TagUiIopinSelected : public TagBase{
+class TagUiIopinSelected : public TagHandler{
  public:
-  TagUiIopinSelected(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "selected"),
-                        children{
-                        } {}
-  TagBase* children[0];
-  
-  int values[11] = {0,1,2,3,4,5,12,13,14,15,16};  // Valid output pins.
-
-  bool contentsAt(uint8_t index, String& content, int& value){
+  static bool contentsAt(TagBase& tag, uint8_t index, String& content, int& value){
     value = 0;
     content = "un-set";
 
-    if(strcmp(getParent()->getParent()->name, "enable") == 0){
-      value = (config->enableiopin == values[index]);
+    if(tag.getParent()->id() == tag_session_enable_iopin){
+      value = (config->enableiopin == uiIopin(index));
       content = value;
-    } else if(strcmp(getParent()->getParent()->name, "io") == 0){
+    } else if(tag.getParent()->id() == tag_io_iopin){
       // Not every config->devices entry is populated.
-      value = config->labelToIndex(getParent()->sequence);
+      value = config->labelToIndex(tag.getParent()->sequence);
       
-      content = (config->devices[value].iopin == values[index]);
+      content = (config->devices[value].iopin == uiIopin(index));
     }
 
-    return (index < 10);
+    return (index < UI_IOPIN_COUNT -1);
   }
 };
 
-class TagUiIopin : public TagBase{
+class TagUiIopin : public TagHandler{
  public:
-  TagUiIopin(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "iopin"),
-                        children{new TagUiIopinValue(COMMON_PERAMS),
-                                 new TagUiIopinSelected(COMMON_PERAMS)
-                        } {
-    configurable = true;
-    direct_value = true;
-                        }
-  TagBase* children[2];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& tag, uint8_t /*index*/, String& content, int& value){
     value = 0;
     content = "un-set";
 
-    if(strcmp(getParent()->name, "enable") == 0){
+    if(tag.id() == tag_session_enable_iopin){
       value = config->enableiopin;
       content = value;
-    } else if(strcmp(getParent()->name, "io") == 0){
+    } else if(tag.id() == tag_io_iopin){
       // Not every config->devices entry is populated.
-      value = config->labelToIndex(sequence);
+      value = config->labelToIndex(tag.sequence);
       
       content = config->devices[value].iopin;
       value = config->devices[value].iopin;
@@ -231,107 +638,83 @@ class TagUiIopin : public TagBase{
     return false;
   }
 
-  uint8_t contentCount(){
-    return 11;
+  static uint8_t contentCount(TagBase& /*tag*/){
+    return UI_IOPIN_COUNT;
   }
   
-  bool contentsSave(const String& content){
+  static bool contentsSave(TagBase& tag, const String& content){
     /*Serial.print("TagUiIoPin.contentsSave(");
     Serial.print(content);
     Serial.println(")");
-    Serial.println(getParent()->name);*/
+    Serial.println(tag.getParent()->name());*/
 
-    if(strcmp(getParent()->name, "enable") == 0){
+    if(tag.id() == tag_session_enable_iopin){
       config->enableiopin = content.toInt();
-    } else if(strcmp(getParent()->name, "io") == 0){
+    } else if(tag.id() == tag_io_iopin){
       // Not every config->devices entry is populated.
-      uint8_t value = config->labelToIndex(sequence);
+      uint8_t value = config->labelToIndex(tag.sequence);
 
       config->devices[value].iopin = content.toInt();
+      io->invalidateAnnounce();
     }
     return true;
   }
 };
 
-class TagUiIotypeSelected : public TagBase{
+class TagUiIotypeSelected : public TagHandler{
  public:
-  TagUiIotypeSelected(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "selected"),
-                        children{
-                        } {}
-  TagBase* children[0];
-
-  bool contentsAt(uint8_t index, String& content, int& value){
+  static bool contentsAt(TagBase& tag, uint8_t index, String& content, int& value){
     // Not every config->devices entry is populated.
-    value = config->labelToIndex(getParent()->sequence);
+    value = config->labelToIndex(tag.getParent()->sequence);
 
     content = (config->devices[value].io_type == index);
 
-    return (index < 5);
+    return (index < IO_TYPE_COUNT -1);
   }
 };
 
-class TagUiIotypeValue : public TagBase{
+class TagUiIotypeValue : public TagHandler{
  public:
-  TagUiIotypeValue(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "value"),
-                        children{
-                        } {}
-  TagBase* children[0];
-
-  const char values[6][12] = {"test", "onoff", "pwm", "inputpullup", "input", "timer"};
-  
-  bool contentsAt(uint8_t index, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t index, String& content, int& value){
     value = index;
-    content = values[index];
-    return (index < 5);
+    content = TypeToString((Io_Type)index);
+    return (index < IO_TYPE_COUNT -1);
   }
 };
 
-class TagUiIotype : public TagBase{
+class TagUiIotype : public TagHandler{
  public:
-  TagUiIotype(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "iotype"),
-                        children{new TagUiIotypeValue(COMMON_PERAMS),
-                                 new TagUiIotypeSelected(COMMON_PERAMS)
-                        } {
-    configurable = true;
-    direct_value = true;
-                        }
-  TagBase* children[2];
-  
-  const char values[6][12] = {"test", "onoff", "pwm", "inputpullup", "input", "timer"};
-  
-  uint8_t contentCount(){
-    return 6;
+  static uint8_t contentCount(TagBase& /*tag*/){
+    return IO_TYPE_COUNT;
   }
   
-  bool contentsSave(const String& content){
+  static bool contentsSave(TagBase& tag, const String& content){
     /*Serial.print("TagUiIoType.contentsSave(");
     Serial.print(content);
     Serial.println(")");*/
 
     // Not every config->devices entry is populated.
-    uint8_t value = config->labelToIndex(sequence);
+    uint8_t value = config->labelToIndex(tag.sequence);
 
     config->devices[value].setType(content);
+    // Counters and DHT22s have an extra slot in their "_announce" template.
+    io->invalidateAnnounce();
     return true;
   }
   
-  bool contentsAt(uint8_t index, String& content, int& value){
+  static bool contentsAt(TagBase& tag, uint8_t index, String& content, int& value){
     // Not every config->devices entry is populated.
-    value = config->labelToIndex(sequence);
+    value = config->labelToIndex(tag.sequence);
 
-    content = values[config->devices[value].io_type];
+    content = TypeToString(config->devices[value].io_type);
 
-    return (index < 5);
+    return (index < IO_TYPE_COUNT -1);
   }
 };
 
-class TagSessionValid : public TagBase{
+class TagSessionValid : public TagHandler{
  public:
-  TagSessionValid(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "valid"),
-                                children{} { }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     const unsigned int now = millis() / 1000;
     const int remaining = config->session_time + SESSION_TIMEOUT - now;
     if(config->sessionValid() && remaining > 0){
@@ -345,7 +728,7 @@ class TagSessionValid : public TagBase{
     return false;
   }
 
-  uint8_t contentCount(){
+  static uint8_t contentCount(TagBase& /*tag*/){
     const unsigned int now = millis() / 1000;
     const int remaining = config->session_time + SESSION_TIMEOUT - now;
     if(config->sessionValid() && remaining > 0){
@@ -355,74 +738,51 @@ class TagSessionValid : public TagBase{
   }
 };
 
-class TagSessionValiduntil : public TagBase{
+class TagSessionValiduntil : public TagHandler{
  public:
-  TagSessionValiduntil(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "validuntil"),
-                                     children{} { }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     value = config->session_time + SESSION_TIMEOUT;
     content = "";
     return false;
   }
 };
 
-class TagSessionProvidedtoken : public TagBase{
+class TagSessionProvidedtoken : public TagHandler{
  public:
-  TagSessionProvidedtoken(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "providedtoken"),
-                                        children{} { }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     value = config->session_token_provided;
     content = config->session_token_provided;
     return false;
   }
 };
 
-class TagSessionExpectedtoken : public TagBase{
+class TagSessionExpectedtoken : public TagHandler{
  public:
-  TagSessionExpectedtoken(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "expectedtoken"),
-                                        children{} { }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     value = config->session_token;
     content = config->session_token;
     return false;
   }
 };
 
-class TagSessionOverrideauth : public TagBase{
+class TagSessionOverrideauth : public TagHandler{
  public:
-  TagSessionOverrideauth(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "overrideauth"),
-                                        children{} { }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     value = config->session_override;
     content = config->session_override;
     return false;
   }
 };
 
-class TagSessionEnablePassword : public TagBase{
+class TagSessionEnablePassword : public TagHandler{
  public:
-  TagSessionEnablePassword(COMMON_DEF) :
-    TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "password"),
-                                children{} {
-    configurable = true;
-                                }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     value = 0;
     content = "****";
     return false;
   }
   
-  bool contentsSave(const String& content){
+  static bool contentsSave(TagBase& /*tag*/, const String& content){
     /*Serial.print("TagSessionEnablePassword.contentsSave(");
     Serial.print(content);
     Serial.println(")");*/
@@ -432,45 +792,15 @@ class TagSessionEnablePassword : public TagBase{
   }
 };
 
-class TagSessionEnable : public TagBase{
- public:
-  TagSessionEnable(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "enable"),
-                                        children{
-                                          new TagUiIopin(COMMON_PERAMS),
-                                          new TagSessionEnablePassword(COMMON_PERAMS),
-                                        } {}
-  TagBase* children[2];
-};
-
-class TagSession : public TagBase{
- public:
-  TagSession(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "session"),
-                           children{new TagSessionValid(COMMON_PERAMS),
-                                    new TagSessionValiduntil(COMMON_PERAMS),
-                                    new TagSessionProvidedtoken(COMMON_PERAMS),
-                                    new TagSessionExpectedtoken(COMMON_PERAMS),
-                                    new TagSessionOverrideauth(COMMON_PERAMS),
-                                    new TagSessionEnable(COMMON_PERAMS),
-                           } { }
-  TagBase* children[6];
-};
-
-class TagHostHostname : public TagBase{
+class TagHostHostname : public TagHandler{
  public:
-  TagHostHostname(COMMON_DEF) :
-    TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "hostname"),
-                                children{} {
-    configurable = true;
-                                }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     value = 0;
     content = config->hostname;
     return false;
   }
   
-  bool contentsSave(const String& content){
+  static bool contentsSave(TagBase& /*tag*/, const String& content){
     /*Serial.print("TagHostHostname.contentsSave(");
     Serial.print(content);
     Serial.println(")");*/
@@ -478,17 +808,15 @@ class TagHostHostname : public TagBase{
     content.toCharArray(config->hostname, HOSTNAME_LEN);
     sanitizeHostname(config->hostname);
     WiFi.hostname(config->hostname);
+    // The status topic includes the hostname.
+    mqtt->reconfigure();
     return true;
   }
 };
 
-class TagHostMac : public TagBase{
+class TagHostMac : public TagHandler{
  public:
-  TagHostMac(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "mac"),
-                           children{} { }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     value = 0;
     uint8_t mac[6];
     WiFi.macAddress(mac);
@@ -497,13 +825,9 @@ class TagHostMac : public TagBase{
   }
 };
 
-class TagHostUptime : public TagBase{
+class TagHostUptime : public TagHandler{
  public:
-  TagHostUptime(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "uptime"),
-                           children{} { }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     value = millis() / 1000;
     content = (millis() / 1000);
     content += " seconds";
@@ -511,13 +835,18 @@ class TagHostUptime : public TagBase{
   }
 };
 
-class TagHostRssi : public TagBase{
+class TagHostAnnouncesuppressed : public TagHandler{
  public:
-  TagHostRssi(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "rssi"),
-                           children{} { }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
+    value = io->announceSuppressedTotal();
+    content = value;
+    return false;
+  }
+};
+
+class TagHostRssi : public TagHandler{
+ public:
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     value = WiFi.RSSI();
     content = WiFi.RSSI();
     content += "dBm";
@@ -525,13 +854,9 @@ class TagHostRssi : public TagBase{
   }
 };
 
-class TagHostCoreCpuspeed : public TagBase{
+class TagHostCoreCpuspeed : public TagHandler{
  public:
-  TagHostCoreCpuspeed(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "cpu_speed"),
-                                 children{} { }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     value = ESP.getCpuFreqMHz();
     content = ESP.getCpuFreqMHz();
     content += "MHz";
@@ -539,13 +864,9 @@ class TagHostCoreCpuspeed : public TagBase{
   }
 };
 
-class TagHostCoreFlashsize : public TagBase{
+class TagHostCoreFlashsize : public TagHandler{
  public:
-  TagHostCoreFlashsize(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "flash_size"),
-                                 children{} { }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     value = ESP.getFlashChipSize();
     content = (ESP.getFlashChipSize() / 1024);
     content += "k";
@@ -553,13 +874,9 @@ class TagHostCoreFlashsize : public TagBase{
   }
 };
 
-class TagHostCoreFlashspeed : public TagBase{
+class TagHostCoreFlashspeed : public TagHandler{
  public:
-  TagHostCoreFlashspeed(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "flash_speed"),
-                                 children{} { }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     value = 0;
     content = ESP.getFlashChipSpeed() / 1000000;
     content += "MHz";
@@ -567,13 +884,9 @@ class TagHostCoreFlashspeed : public TagBase{
   }
 };
 
-class TagHostCoreFlashfree : public TagBase{
+class TagHostCoreFlashfree : public TagHandler{
  public:
-  TagHostCoreFlashfree(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "flash_free"),
-                                 children{} { }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     value = ESP.getFreeSketchSpace();
     content = (ESP.getFreeSketchSpace() / 1024);
     content += "k";
@@ -581,13 +894,9 @@ class TagHostCoreFlashfree : public TagBase{
   }
 };
 
-class TagHostCoreFlashratio : public TagBase{
+class TagHostCoreFlashratio : public TagHandler{
  public:
-  TagHostCoreFlashratio(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "flash_ratio"),
-                                 children{} { }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     value = 0;
     content = "";
     if(ESP.getFlashChipSize() > 0){
@@ -599,13 +908,9 @@ class TagHostCoreFlashratio : public TagBase{
   }
 };
 
-class TagHostCoreRamfree : public TagBase{
+class TagHostCoreRamfree : public TagHandler{
  public:
-  TagHostCoreRamfree(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "ram_free"),
-                                 children{} { }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     value = ESP.getFreeHeap();
     content = (ESP.getFreeHeap() / 1024);
     content += "k";
@@ -613,78 +918,54 @@ class TagHostCoreRamfree : public TagBase{
   }
 };
 
-class TagHostCoreSdkversion : public TagBase{
+class TagHostCoreSdkversion : public TagHandler{
  public:
-  TagHostCoreSdkversion(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "sdk_version"),
-                                 children{} { }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     value = 0;
     content = ESP.getSdkVersion();
     return false;
   }
 };
 
-class TagHostCoreCoreversion : public TagBase{
+class TagHostCoreCoreversion : public TagHandler{
  public:
-  TagHostCoreCoreversion(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "core_version"),
-                                 children{} { }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     value = 0;
     content = ESP.getCoreVersion();
     return false;
   }
 };
 
-class TagHostCoreResetreason : public TagBase{
+class TagHostCoreResetreason : public TagHandler{
  public:
-  TagHostCoreResetreason(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "reset_reason"),
-                                 children{} { }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     value = 0;
     content = ESP.getResetReason();
     return false;
   }
 };
 
-class TagHostCoreChipid : public TagBase{
+class TagHostCoreChipid : public TagHandler{
  public:
-  TagHostCoreChipid(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "chip_id"),
-                                 children{} { }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     value = 0;
     content = ESP.getChipId();
     return false;
   }
 };
 
-class TagHostCoreCpucycles : public TagBase{
+class TagHostCoreCpucycles : public TagHandler{
  public:
-  TagHostCoreCpucycles(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "cpu_cycles"),
-                                 children{} { }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     value = ESP.getCycleCount();
     content = value;
     return false;
   }
 };
 
-class TagHostCoreUptime : public TagBase{
+class TagHostCoreUptime : public TagHandler{
  public:
-  TagHostCoreUptime(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "uptime"),
-                                 children{} { }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     value = millis() / 1000;
     content = value;
     content += "seconds";
@@ -692,89 +973,60 @@ class TagHostCoreUptime : public TagBase{
   }
 };
 
-class TagHostCore : public TagBase{
+class TagHostCoreMemohits : public TagHandler{
  public:
-  TagHostCore(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "core"),
-                          children{new TagHostCoreCpuspeed(COMMON_PERAMS),
-                                   new TagHostCoreFlashsize(COMMON_PERAMS),
-                                   new TagHostCoreFlashfree(COMMON_PERAMS),
-                                   new TagHostCoreFlashratio(COMMON_PERAMS),
-                                   new TagHostCoreFlashspeed(COMMON_PERAMS),
-                                   new TagHostCoreRamfree(COMMON_PERAMS),
-                                   new TagHostCoreSdkversion(COMMON_PERAMS),
-                                   new TagHostCoreCoreversion(COMMON_PERAMS),
-                                   new TagHostCoreResetreason(COMMON_PERAMS),
-                                   new TagHostCoreChipid(COMMON_PERAMS),
-                                   new TagHostCoreCpucycles(COMMON_PERAMS),
-                                   new TagHostCoreUptime(COMMON_PERAMS)
-                          } { }
-  TagBase* children[12];
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
+    value = tag_memo.hits;
+    content = value;
+    return false;
+  }
 };
 
-class TagHostNwAddress : public TagBase{
+class TagHostCoreMemomisses : public TagHandler{
  public:
-  TagHostNwAddress(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "address"),
-                                 children{} { }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
+    value = tag_memo.misses;
+    content = value;
+    return false;
+  }
+};
+
+class TagHostNwAddress : public TagHandler{
+ public:
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     value = 0;
     content = ip_to_string(WiFi.localIP());
     return false;
   }
 };
 
-class TagHostNwGateway : public TagBase{
+class TagHostNwGateway : public TagHandler{
  public:
-  TagHostNwGateway(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "gateway"),
-                                 children{} { }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     value = 0;
     content = ip_to_string(WiFi.gatewayIP());
     return false;
   }
 };
 
-class TagHostNwSubnet : public TagBase{
+class TagHostNwSubnet : public TagHandler{
  public:
-  TagHostNwSubnet(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "subnet"),
-                                children{} { }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     value = 0;
     content = ip_to_string(WiFi.subnetMask());
     return false;
   }
 };
 
-class TagHostNw : public TagBase{
- public:
-  TagHostNw(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "nw"),
-                          children{new TagHostNwAddress(COMMON_PERAMS),
-                                   new TagHostNwGateway(COMMON_PERAMS),
-                                   new TagHostNwSubnet(COMMON_PERAMS)} { }
-  TagBase* children[3];
-};
-
-class TagHostNwconfiguredAddress : public TagBase{
+class TagHostNwconfiguredAddress : public TagHandler{
  public:
-  TagHostNwconfiguredAddress(COMMON_DEF) :
-    TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "address"),
-                                           children{} {
-    configurable = true;
-                                           }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     value = 0;
     content = ip_to_string(config->ip);
     return false;
   }
   
-  bool contentsSave(const String& content){
+  static bool contentsSave(TagBase& /*tag*/, const String& content){
     /*Serial.print("TagHostNwconfiguredAddress.contentsSave(");
     Serial.print(content);
     Serial.println(")");*/
@@ -784,22 +1036,15 @@ class TagHostNwconfiguredAddress : public TagBase{
   }
 };
 
-class TagHostNwconfiguredGateway : public TagBase{
+class TagHostNwconfiguredGateway : public TagHandler{
  public:
-  TagHostNwconfiguredGateway(COMMON_DEF) :
-    TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "gateway"),
-                                           children{} {
-    configurable = true;
-                                           }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     value = 0;
     content = ip_to_string(config->gateway);
     return false;
   }
   
-  bool contentsSave(const String& content){
+  static bool contentsSave(TagBase& /*tag*/, const String& content){
     /*Serial.print("TagHostNwconfiguredGateway.contentsSave(");
     Serial.print(content);
     Serial.println(")");*/
@@ -809,22 +1054,15 @@ class TagHostNwconfiguredGateway : public TagBase{
   }
 };
 
-class TagHostNwconfiguredSubnet : public TagBase{
+class TagHostNwconfiguredSubnet : public TagHandler{
  public:
-  TagHostNwconfiguredSubnet(COMMON_DEF) :
-    TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "subnet"),
-                                          children{} {
-    configurable = true;
-                                          }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     value = 0;
     content = ip_to_string(config->subnet);
     return false;
   }
   
-  bool contentsSave(const String& content){
+  static bool contentsSave(TagBase& /*tag*/, const String& content){
     /*Serial.print("TagHostNwconfiguredSubnet.contentsSave(");
     Serial.print(content);
     Serial.println(")");*/
@@ -834,54 +1072,32 @@ class TagHostNwconfiguredSubnet : public TagBase{
   }
 };
 
-class TagHostNwconfigured : public TagBase{
+class TagHostSsidsName : public TagHandler{
  public:
-  TagHostNwconfigured(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "nwconfigured"),
-                                    children{new TagHostNwconfiguredAddress(COMMON_PERAMS),
-                                             new TagHostNwconfiguredGateway(COMMON_PERAMS),
-                                             new TagHostNwconfiguredSubnet(COMMON_PERAMS)} { }
-  TagBase* children[3];
-};
-
-class TagHostSsidsName : public TagBase{
- public:
-  TagHostSsidsName(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "name"),
-                                          children{} { }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t index, String& content, int& value){
-    parent->contentCount();
+  static bool contentsAt(TagBase& tag, uint8_t index, String& content, int& value){
+    tag.getParent()->contentCount();
 
     value = WiFi.RSSI(index);
     content = WiFi.SSID(index);
-    return (index < parent->contentCount() -1);
+    return (index < tag.getParent()->contentCount() -1);
   }
 };
 
-class TagHostSsidsSignal : public TagBase{
+class TagHostSsidsSignal : public TagHandler{
  public:
-  TagHostSsidsSignal(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "signal"),
-                                          children{} { }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t index, String& content, int& value){
-    parent->contentCount();
+  static bool contentsAt(TagBase& tag, uint8_t index, String& content, int& value){
+    tag.getParent()->contentCount();
 
     value = WiFi.RSSI(index);
     content = value;
     content += "dBm";
-    return (index < parent->contentCount() -1);
+    return (index < tag.getParent()->contentCount() -1);
   }
 };
 
-class TagHostSsids : public TagBase{
+class TagHostSsids : public TagHandler{
  public:
-  TagHostSsids(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "ssids"),
-                                    children{new TagHostSsidsName(COMMON_PERAMS),
-                                             new TagHostSsidsSignal(COMMON_PERAMS)} { }
-  TagBase* children[2];
-  
-  uint8_t contentCount(){
+  static uint8_t contentCount(TagBase& /*tag*/){
     static const uint8_t UPDATE_EVERY = 30;  // seconds.
     uint32_t now = millis() / 1000;
     static uint32_t last_updated = 0;
@@ -890,26 +1106,23 @@ class TagHostSsids : public TagBase{
       wifi_count = WiFi.scanNetworks();
     }
     last_updated = now;
+    if(wifi_count < 0){
+      // Scan failed.
+      return 0;
+    }
     return wifi_count;
   }
 };
 
-class TagHostMqttBrokerAddress : public TagBase{
+class TagHostMqttBrokerAddress : public TagHandler{
  public:
-  TagHostMqttBrokerAddress(COMMON_DEF) :
-    TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "address"),
-                                    children{ } {
-    configurable = true;
-                                    }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     value = config->brokerip;
     content = ip_to_string(config->brokerip);
     return false;
   }
   
-  bool contentsSave(const String& content){
+  static bool contentsSave(TagBase& /*tag*/, const String& content){
     /*Serial.print("TagHostMqttBrokerAddress.contentsSave(");
     Serial.print(content);
     Serial.println(")");*/
@@ -918,22 +1131,16 @@ class TagHostMqttBrokerAddress : public TagBase{
     return true;
   }
 };
-  
-class TagHostMqttBrokerPort : public TagBase{
+
+class TagHostMqttBrokerPort : public TagHandler{
  public:
-  TagHostMqttBrokerPort(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "port"),
-                                    children{ } {
-    configurable = true;
-                                    }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     value = config->brokerport;
     content = config->brokerport;
     return false;
   }
 
-  bool contentsSave(const String& content){
+  static bool contentsSave(TagBase& /*tag*/, const String& content){
     /*Serial.print("TagHostMqttBrokerPort.contentsSave(");
     Serial.print(content);
     Serial.println(")");*/
@@ -942,33 +1149,16 @@ class TagHostMqttBrokerPort : public TagBase{
     return true;
   }
 };
-  
-class TagHostMqttBroker : public TagBase{
- public:
-  TagHostMqttBroker(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "broker"),
-                                    children{new TagHostMqttBrokerAddress(COMMON_PERAMS),
-                                             new TagHostMqttBrokerPort(COMMON_PERAMS),
-                                    } { }
-  TagBase* children[2];
-};
-  
-class TagHostMqttSubscriptionprefix : public TagBase{
- public:
-  TagHostMqttSubscriptionprefix(COMMON_DEF) : 
-    TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "subscribe_prefix"),
-                                    children{ } {
 
-    configurable = true;
-                                    }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+class TagHostMqttSubscriptionprefix : public TagHandler{
+ public:
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     value = 0;
     content = config->subscribeprefix;
     return false;
   }
 
-  bool contentsSave(const String& content){
+  static bool contentsSave(TagBase& /*tag*/, const String& content){
     /*Serial.print("TagHostMqttSubscriptionprefix.contentsSave(");
     Serial.print(content);
     Serial.println(")");*/
@@ -978,59 +1168,96 @@ class TagHostMqttSubscriptionprefix : public TagBase{
     return true;
   }
 };
-  
-class TagHostMqttPublishprefix : public TagBase{
- public:
-  TagHostMqttPublishprefix(COMMON_DEF) :
-    TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "publish_prefix"),
-                                    children{ } {
-    configurable = true;
-                                    }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+
+class TagHostMqttPublishprefix : public TagHandler{
+ public:
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     value = 0;
     content = config->publishprefix;
     return false;
   }
   
-  bool contentsSave(const String& content){
+  static bool contentsSave(TagBase& /*tag*/, const String& content){
     /*Serial.print("TagHostMqttPublishprefix.contentsSave(");
     Serial.print(content);
     Serial.println(")");*/
 
     content.toCharArray(config->publishprefix, PREFIX_LEN);
     sanitizeTopic(config->publishprefix);
+    io->invalidateAnnounce();
+    mqtt->reconfigure();
     return true;
   }
 };
-  
-class TagHostMqtt : public TagBase{
+
+class TagHostMqttSolicitwindow : public TagHandler{
+ public:
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
+    value = config->solicit_window;
+    content = value;
+    return false;
+  }
+
+  static bool contentsSave(TagBase& /*tag*/, const String& content){
+    config->solicit_window = content.toInt();
+    return true;
+  }
+};
+
+class TagHostMqttCommandsDepth : public TagHandler{
  public:
-  TagHostMqtt(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "mqtt"),
-                                    children{new TagHostMqttBroker(COMMON_PERAMS),
-                                             new TagHostMqttSubscriptionprefix(COMMON_PERAMS),
-                                             new TagHostMqttPublishprefix(COMMON_PERAMS),
-                                    } { }
-  TagBase* children[3];
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
+    value = mqtt->commandDepth();
+    content = value;
+    return false;
+  }
 };
-  
-class TagHostHttpAddress : public TagBase{
- public:
-  TagHostHttpAddress(COMMON_DEF) :
-    TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "address"),
-                                    children{ } {
-    configurable = true;
-                                    }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+
+class TagHostMqttCommandsDepthmax : public TagHandler{
+ public:
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
+    value = mqtt->command_depth_max;
+    content = value;
+    return false;
+  }
+};
+
+class TagHostMqttCommandsDrops : public TagHandler{
+ public:
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
+    value = mqtt->command_drops;
+    content = value;
+    return false;
+  }
+};
+
+class TagHostMqttCommandsLatency : public TagHandler{
+ public:
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
+    value = mqtt->command_latency;
+    content = value;
+    return false;
+  }
+};
+
+class TagHostMqttCommandsLatencymax : public TagHandler{
+ public:
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
+    value = mqtt->command_latency_max;
+    content = value;
+    return false;
+  }
+};
+
+class TagHostHttpAddress : public TagHandler{
+ public:
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     value = 0;
     content = config->firmwarehost;
     return false;
   }
 
-  bool contentsSave(const String& content){
+  static bool contentsSave(TagBase& /*tag*/, const String& content){
     /*Serial.print("TagHostHttpAddress.contentsSave(");
     Serial.print(content);
     Serial.println(")");*/
@@ -1042,22 +1269,16 @@ class TagHostHttpAddress : public TagBase{
     return false;
   }
 };
-  
-class TagHostHttpPort : public TagBase{
+
+class TagHostHttpPort : public TagHandler{
  public:
-  TagHostHttpPort(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "port"),
-                                    children{ } {
-    configurable = true;
-                                    }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     value = config->firmwareport;
     content = config->firmwareport;
     return false;
   }
 
-  bool contentsSave(const String& content){
+  static bool contentsSave(TagBase& /*tag*/, const String& content){
     /*Serial.print("TagHostHttpPort.contentsSave(");
     Serial.print(content);
     Serial.println(")");*/
@@ -1066,22 +1287,16 @@ class TagHostHttpPort : public TagBase{
     return true;
   }
 };
-  
-class TagHostHttpDirectory : public TagBase{
+
+class TagHostHttpDirectory : public TagHandler{
  public:
-  TagHostHttpDirectory(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "directory"),
-                                    children{ } {
-    configurable = true;
-                                    }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     value = 0;
     content = config->firmwaredirectory;
     return false;
   }
   
-  bool contentsSave(const String& content){
+  static bool contentsSave(TagBase& /*tag*/, const String& content){
     /*Serial.print("TagHostHttpDirectory.contentsSave(");
     Serial.print(content);
     Serial.println(")");*/
@@ -1093,47 +1308,17 @@ class TagHostHttpDirectory : public TagBase{
     return false;
   }
 };
-  
-class TagHostHttp : public TagBase{
+
+class TagServersMqttActive : public TagHandler{
  public:
-  TagHostHttp(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "http"),
-                                    children{new TagHostHttpAddress(COMMON_PERAMS),
-                                             new TagHostHttpPort(COMMON_PERAMS),
-                                             new TagHostHttpDirectory(COMMON_PERAMS),
-                                    } { }
-  TagBase* children[3];
-};
-  
-class TagHost : public TagBase{
- public:
-  TagHost(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "host"),
-                        children{new TagHostHostname(COMMON_PERAMS),
-                                 new TagHostMac(COMMON_PERAMS),
-                                 new TagHostUptime(COMMON_PERAMS),
-                                 new TagHostRssi(COMMON_PERAMS),
-                                 new TagHostCore(COMMON_PERAMS),
-                                 new TagHostNw(COMMON_PERAMS),
-                                 new TagHostNwconfigured(COMMON_PERAMS),
-                                 new TagHostSsids(COMMON_PERAMS),
-                                 new TagHostMqtt(COMMON_PERAMS),
-                                 new TagHostHttp(COMMON_PERAMS),
-                        } { }
-  TagBase* children[10];
-};
-
-class TagServersMqttActive : public TagBase{
- public:
-  TagServersMqttActive(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "active"),
-                        children{ } {}
-  TagBase* children[0];
-  bool contentsAt(uint8_t index, String& content, int& value){
+  static bool contentsAt(TagBase& tag, uint8_t index, String& content, int& value){
     Host* p_host;
     bool active;
     brokers->SetIterater(index);
     brokers->GetLastHost(&p_host, active);
     content = (active ? "Y":"N");
     value = active;
-    return (index < parent->contentCount() -1);
+    return (index < tag.getParent()->contentCount() -1);
   }
   //uint8_t contentCount(){
     //if(){
@@ -1143,169 +1328,126 @@ class TagServersMqttActive : public TagBase{
   //}
 };
 
-class TagServersMqttServicename : public TagBase{
+class TagServersMqttServicename : public TagHandler{
  public:
-  TagServersMqttServicename(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "service_name"), 
-                        children{ } {}
-  TagBase* children[0];
-  bool contentsAt(uint8_t index, String& content, int& value){
+  static bool contentsAt(TagBase& tag, uint8_t index, String& content, int& value){
     Host* p_host;
     bool active;
     brokers->SetIterater(index);
     brokers->GetLastHost(&p_host, active);
     content = p_host->service_name;
     value = active; 
-    return (index < parent->contentCount() -1);
+    return (index < tag.getParent()->contentCount() -1);
   }
 };
 
-class TagServersMqttHostname : public TagBase{
+class TagServersMqttHostname : public TagHandler{
  public:
-  TagServersMqttHostname(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "host_name"),
-                        children{ } {}
-  TagBase* children[0];
-  bool contentsAt(uint8_t index, String& content, int& value){
+  static bool contentsAt(TagBase& tag, uint8_t index, String& content, int& value){
     Host* p_host;
     bool active;
     brokers->SetIterater(index);
     brokers->GetLastHost(&p_host, active);
     content = p_host->host_name;
     value = active; 
-    return (index < parent->contentCount() -1);
+    return (index < tag.getParent()->contentCount() -1);
   }
 };
 
-class TagServersMqttAddress : public TagBase{
+class TagServersMqttAddress : public TagHandler{
  public:
-  TagServersMqttAddress(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "address"),
-                        children{ } {}
-  TagBase* children[0];
-  bool contentsAt(uint8_t index, String& content, int& value){
+  static bool contentsAt(TagBase& tag, uint8_t index, String& content, int& value){
     Host* p_host;
     bool active;
     brokers->SetIterater(index);
     brokers->GetLastHost(&p_host, active);
     content = ip_to_string(p_host->address);
     value = active; 
-    return (index < parent->contentCount() -1);
+    return (index < tag.getParent()->contentCount() -1);
   }
 };
 
-class TagServersMqttPort : public TagBase{
+class TagServersMqttPort : public TagHandler{
  public:
-  TagServersMqttPort(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "port"),
-                        children{ } {}
-  TagBase* children[0];
-  bool contentsAt(uint8_t index, String& content, int& value){
+  static bool contentsAt(TagBase& tag, uint8_t index, String& content, int& value){
     Host* p_host;
     bool active;
     brokers->SetIterater(index);
     brokers->GetLastHost(&p_host, active);
     content = p_host->port;
     value = p_host->port; 
-    return (index < parent->contentCount() -1);
+    return (index < tag.getParent()->contentCount() -1);
   }
 };
 
-class TagServersMqttServicevaliduntil : public TagBase{
+class TagServersMqttServicevaliduntil : public TagHandler{
  public:
-  TagServersMqttServicevaliduntil(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "service_valid_until"),
-                        children{ } {}
-  TagBase* children[0];
-  bool contentsAt(uint8_t index, String& content, int& value){
+  static bool contentsAt(TagBase& tag, uint8_t index, String& content, int& value){
     Host* p_host;
     bool active;
     brokers->SetIterater(index);
     brokers->GetLastHost(&p_host, active);
     content = p_host->service_valid_until;
     value = p_host->service_valid_until; 
-    return (index < parent->contentCount() -1);
+    return (index < tag.getParent()->contentCount() -1);
   }
 };
 
-class TagServersMqttHostvaliduntil : public TagBase{
+class TagServersMqttHostvaliduntil : public TagHandler{
  public:
-  TagServersMqttHostvaliduntil(COMMON_DEF) :
-    TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "host_valid_until"), 
-                        children{ } {}
-  TagBase* children[0];
-  bool contentsAt(uint8_t index, String& content, int& value){
+  static bool contentsAt(TagBase& tag, uint8_t index, String& content, int& value){
     Host* p_host;
     bool active;
     brokers->SetIterater(index);
     brokers->GetLastHost(&p_host, active);
     content = p_host->host_valid_until;
     value = p_host->host_valid_until; 
-    return (index < parent->contentCount() -1);
+    return (index < tag.getParent()->contentCount() -1);
   }
 };
 
-class TagServersMqttAddressvaliduntil : public TagBase{
+class TagServersMqttAddressvaliduntil : public TagHandler{
  public:
-  TagServersMqttAddressvaliduntil(COMMON_DEF) :
-    TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "address_valid_until"),
-                        children{ } {}
-  TagBase* children[0];
-  bool contentsAt(uint8_t index, String& content, int& value){
+  static bool contentsAt(TagBase& tag, uint8_t index, String& content, int& value){
     Host* p_host;
     bool active;
     brokers->SetIterater(index);
     brokers->GetLastHost(&p_host, active);
     content = p_host->ipv4_valid_until;
     value = p_host->ipv4_valid_until; 
-    return (index < parent->contentCount() -1);
+    return (index < tag.getParent()->contentCount() -1);
   }
 };
 
-class TagServersMqttSuccesscounter : public TagBase{
+class TagServersMqttSuccesscounter : public TagHandler{
  public:
-  TagServersMqttSuccesscounter(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "success_counter"),
-                        children{ } {}
-  TagBase* children[0];
-  bool contentsAt(uint8_t index, String& content, int& value){
+  static bool contentsAt(TagBase& tag, uint8_t index, String& content, int& value){
     Host* p_host;
     bool active;
     brokers->SetIterater(index);
     brokers->GetLastHost(&p_host, active);
     content = p_host->success_counter;
     value = p_host->success_counter; 
-    return (index < parent->contentCount() -1);
+    return (index < tag.getParent()->contentCount() -1);
   }
 };
 
-class TagServersMqttConnectionattempts : public TagBase{
+class TagServersMqttConnectionattempts : public TagHandler{
  public:
-  TagServersMqttConnectionattempts(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "connection_attempts"),
-                        children{ } {}
-  TagBase* children[0];
-  bool contentsAt(uint8_t index, String& content, int& value){
+  static bool contentsAt(TagBase& tag, uint8_t index, String& content, int& value){
     Host* p_host;
     bool active;
     brokers->SetIterater(index);
     brokers->GetLastHost(&p_host, active);
     value = p_host->success_counter + p_host->fail_counter; 
     content = value;
-    return (index < parent->contentCount() -1);
+    return (index < tag.getParent()->contentCount() -1);
   }
 };
 
-class TagServersMqtt : public TagBase{
+class TagServersMqtt : public TagHandler{
  public:
-  TagServersMqtt(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "mqtt"), 
-                        children{new TagServersMqttActive(COMMON_PERAMS),
-                                 new TagServersMqttServicename(COMMON_PERAMS),
-                                 new TagServersMqttHostname(COMMON_PERAMS),
-                                 new TagServersMqttAddress(COMMON_PERAMS),
-                                 new TagServersMqttPort(COMMON_PERAMS),
-                                 new TagServersMqttServicevaliduntil(COMMON_PERAMS),
-                                 new TagServersMqttHostvaliduntil(COMMON_PERAMS),
-                                 new TagServersMqttAddressvaliduntil(COMMON_PERAMS),
-                                 new TagServersMqttSuccesscounter(COMMON_PERAMS),
-                                 new TagServersMqttConnectionattempts(COMMON_PERAMS)
-                        } {}
-  TagBase* children[10];
-  
-  uint8_t contentCount(){
+  static uint8_t contentCount(TagBase& /*tag*/){
     Host* p_host;
     bool active;
     uint8_t count = 0;
@@ -1318,47 +1460,27 @@ class TagServersMqtt : public TagBase{
   }
 };
 
-class TagServers : public TagBase{
+class TagMdnsBuffersuccess : public TagHandler{
  public:
-  TagServers(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "servers"),
-                        children{new TagServersMqtt(COMMON_PERAMS),
-                        } {}
-  TagBase* children[1];
-};
-
-class TagMdnsBuffersuccess : public TagBase{
- public:
-  TagMdnsBuffersuccess(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "buffer_success"),
-                                        children{} { }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     value = mdns->packet_count - mdns->buffer_size_fail;
     content = value;
     return false;
   }
 };
 
-class TagMdnsPacketcount : public TagBase{
+class TagMdnsPacketcount : public TagHandler{
  public:
-  TagMdnsPacketcount(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "packet_count"),
-                                        children{} { }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     value = mdns->packet_count;
     content = value;
     return false;
   }
 };
 
-class TagMdnsSuccessrate : public TagBase{
+class TagMdnsSuccessrate : public TagHandler{
  public:
-  TagMdnsSuccessrate(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "success_rate"),
-                                        children{} { }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     if(mdns->packet_count > 0){
       value = 100 - (100 * mdns->buffer_size_fail / mdns->packet_count);
       content = value;
@@ -1368,53 +1490,55 @@ class TagMdnsSuccessrate : public TagBase{
   }
 };
 
-class TagMdnsLargestpacket : public TagBase{
+class TagMdnsLargestpacket : public TagHandler{
  public:
-  TagMdnsLargestpacket(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "largest_packet"),
-                                        children{} { }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     value = mdns->largest_packet_seen;
     content = value;
     return false;
   }
 };
 
-class TagMdnsBuffersize : public TagBase{
+class TagMdnsBuffersize : public TagHandler{
  public:
-  TagMdnsBuffersize(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "buffer_size"),
-                                        children{} { }
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     value = BUFFER_SIZE;
     content = value;
     return false;
   }
 };
 
-class TagMdns : public TagBase{
+class TagSensorsStepmaxus : public TagHandler{
  public:
-  TagMdns(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "mdns"),
-                        children{new TagMdnsBuffersuccess(COMMON_PERAMS),
-                                 new TagMdnsPacketcount(COMMON_PERAMS),
-                                 new TagMdnsSuccessrate(COMMON_PERAMS),
-                                 new TagMdnsLargestpacket(COMMON_PERAMS),
-                                 new TagMdnsBuffersize(COMMON_PERAMS)
-                        } {}
-  TagBase* children[5];
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
+    value = io->sensor_step_max_us;
+    content = value;
+    return false;
+  }
 };
 
-class TagFsFilesFilename : public TagBase{
+class TagSensorsOverruns : public TagHandler{
  public:
-  TagFsFilesFilename(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "filename"),
-                        children{
-                        } {}
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t index, String& content, int& value){
-    unsigned int file_count = parent->contentCount();
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
+    value = io->sensor_overruns;
+    content = value;
+    return false;
+  }
+};
+
+class TagSensorsBudgetus : public TagHandler{
+ public:
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
+    value = SENSOR_STEP_BUDGET_US;
+    content = value;
+    return false;
+  }
+};
+
+class TagFsFilesFilename : public TagHandler{
+ public:
+  static bool contentsAt(TagBase& tag, uint8_t index, String& content, int& value){
+    unsigned int file_count = tag.getParent()->contentCount();
 
     uint16_t pointer = 1;
     for(uint8_t i = 0; i < index; i++){
@@ -1427,15 +1551,10 @@ class TagFsFilesFilename : public TagBase{
   }
 };
 
-class TagFsFilesSize : public TagBase{
+class TagFsFilesSize : public TagHandler{
  public:
-  TagFsFilesSize(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "size"),
-                        children{
-                        } {}
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t index, String& content, int& value){
-    unsigned int file_count = parent->contentCount();
+  static bool contentsAt(TagBase& tag, uint8_t index, String& content, int& value){
+    unsigned int file_count = tag.getParent()->contentCount();
 
     uint16_t pointer = 1;
     for(uint8_t i = 0; i < index; i++){
@@ -1450,47 +1569,28 @@ class TagFsFilesSize : public TagBase{
   }
 };
 
-class TagFsFilesIsmustache : public TagBase{
+class TagFsFilesIsmustache : public TagHandler{
  public:
-  TagFsFilesIsmustache(COMMON_DEF) :
-    TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "is_mustache"),
-                        children{
-                        } {}
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t index, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t index, String& content, int& value){
     String file_content;
     int file_value;
-    bool return_val = false;
-
-    for(uint8_t i = 0; i < parent->children_len; i++){
-      if(strcmp(parent->getChild(i)->name, "filename") == 0){
-        return_val = parent->getChild(i)->contentsAt(index, file_content, file_value);
-      }
-    }
+    bool return_val = tags[tag_fs_files_filename].contentsAt(index, file_content, file_value);
     value = (int)(file_content.endsWith(".mustache"));
     content = ((bool)value ? "Y":"N");
     return return_val;
   }
 
-  uint8_t contentCount(){
+  static uint8_t contentCount(TagBase& tag){
     String content;
     int value;
-    parent->contentsAt(0, content, value);
+    tag.getParent()->contentsAt(0, content, value);
     return (bool)value;
   }
 };
 
-class TagFsFiles : public TagBase{
+class TagFsFiles : public TagHandler{
  public:
-  TagFsFiles(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "files"),
-                        children{new TagFsFilesFilename(COMMON_PERAMS),
-                                 new TagFsFilesSize(COMMON_PERAMS),
-                                 new TagFsFilesIsmustache(COMMON_PERAMS)
-                        } {}
-  TagBase* children[3];
-  
-  uint8_t contentCount(){
+  static uint8_t contentCount(TagBase& /*tag*/){
     int8_t file_count = 0;
     if(config->files == "0"){
       if(!SPIFFS.begin()){
@@ -1518,14 +1618,9 @@ class TagFsFiles : public TagBase{
   }
 };
 
-class TagFsSpaceSize: public TagBase{
+class TagFsSpaceSize : public TagHandler{
  public:
-  TagFsSpaceSize(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "size"),
-                        children{
-                        } {}
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     if(!SPIFFS.begin()){
       Serial.println("WARNING: Unable to SPIFFS.begin()");
       return 0;
@@ -1540,14 +1635,9 @@ class TagFsSpaceSize: public TagBase{
   }
 };
 
-class TagFsSpaceUsed : public TagBase{
+class TagFsSpaceUsed : public TagHandler{
  public:
-  TagFsSpaceUsed(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "used"),
-                        children{
-                        } {}
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     if(!SPIFFS.begin()){
       Serial.println("WARNING: Unable to SPIFFS.begin()");
       return 0;
@@ -1562,14 +1652,9 @@ class TagFsSpaceUsed : public TagBase{
   }
 };
 
-class TagFsSpaceRemaining : public TagBase{
+class TagFsSpaceRemaining : public TagHandler{
  public:
-  TagFsSpaceRemaining(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "remaining"),
-                        children{
-                        } {}
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     if(!SPIFFS.begin()){
       Serial.println("WARNING: Unable to SPIFFS.begin()");
       return 0;
@@ -1584,14 +1669,9 @@ class TagFsSpaceRemaining : public TagBase{
   }
 };
 
-class TagFsSpaceRatioused : public TagBase{
+class TagFsSpaceRatioused : public TagHandler{
  public:
-  TagFsSpaceRatioused(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "ratio_used"),
-                        children{
-                        } {}
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     if(!SPIFFS.begin()){
       Serial.println("WARNING: Unable to SPIFFS.begin()");
       return 0;
@@ -1608,15 +1688,9 @@ class TagFsSpaceRatioused : public TagBase{
   }
 };
 
-class TagFsSpaceRatioremaining : public TagBase{
+class TagFsSpaceRatioremaining : public TagHandler{
  public:
-  TagFsSpaceRatioremaining(COMMON_DEF) :
-    TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "ratio_remaining"),
-                        children{
-                        } {}
-  TagBase* children[0];
-  
-  bool contentsAt(uint8_t /*index*/, String& content, int& value){
+  static bool contentsAt(TagBase& /*tag*/, uint8_t /*index*/, String& content, int& value){
     if(!SPIFFS.begin()){
       Serial.println("WARNING: Unable to SPIFFS.begin()");
       return 0;
@@ -1633,151 +1707,424 @@ class TagFsSpaceRatioremaining : public TagBase{
   }
 };
 
-class TagFsSpace : public TagBase{
+class TagIoIndex : public TagHandler{
  public:
-  TagFsSpace(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "space"),
-                        children{new TagFsSpaceSize(COMMON_PERAMS),
-                                 new TagFsSpaceUsed(COMMON_PERAMS),
-                                 new TagFsSpaceRemaining(COMMON_PERAMS),
-                                 new TagFsSpaceRatioused(COMMON_PERAMS),
-                                 new TagFsSpaceRatioremaining(COMMON_PERAMS)
-                        } {}
-  TagBase* children[5];
-};
-
-class TagFs : public TagBase{
- public:
-  TagFs(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "fs"),
-                        children{new TagFsFiles(COMMON_PERAMS),
-                                 new TagFsSpace(COMMON_PERAMS)
-                        } {}
-  TagBase* children[2];
-};
-
-class TagIoIndex : public TagBase{
- public:
-  TagIoIndex(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "index"),
-                        children{
-                        } {}
-
-  TagBase* children[0];
-
-  bool contentsAt(uint8_t index, String& content, int& value){
+  static bool contentsAt(TagBase& tag, uint8_t index, String& content, int& value){
     // Not every config->devices entry is populated.
     value = config->labelToIndex(index);
 
     content = value;
-    return (bool)(getParent()->contentCount() - index -1);
+    return (bool)(tag.getParent()->contentCount() - index -1);
   }
 };
 
-class TagIoTopic : public TagBase{
+class TagIoTopic : public TagHandler{
  public:
-  TagIoTopic(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "topic"),
-                        children{ } {
-    configurable = true;
-                        }
-
-  TagBase* children[0];
-
-  bool contentsAt(uint8_t index, String& content, int& value){
+  static bool contentsAt(TagBase& tag, uint8_t index, String& content, int& value){
     // Not every config->devices entry is populated.
     value = config->labelToIndex(index);
 
     content = DeviceAddress(config->devices[value]);
-    return (bool)(getParent()->contentCount() - index -1);
+    return (bool)(tag.getParent()->contentCount() - index -1);
   }
 
-  bool contentsSave(const String& content){
+  static bool contentsSave(TagBase& tag, const String& content){
     /*Serial.print("TagIoTopic.contentsSave(");
     Serial.print(content);
     Serial.println(")");*/
 
     // Not every config->devices entry is populated.
-    uint8_t value = config->labelToIndex(sequence);
+    uint8_t value = config->labelToIndex(tag.sequence);
 
-    DeviceAddressSet(config->devices[value], content);
+    DeviceAddressSet(value, content);
+    io->invalidateAnnounce();
     return true;
   }
 };
 
-class TagIoInverted : public TagBase{
+class TagIoInverted : public TagHandler{
  public:
-  TagIoInverted(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "inverted"),
-                        children{
-                        } {}
-
-  TagBase* children[0];
-
-  bool contentsAt(uint8_t index, String& content, int& value){
+  static bool contentsAt(TagBase& tag, uint8_t index, String& content, int& value){
     // Not every config->devices entry is populated.
     value = config->labelToIndex(index);
     
     content = config->devices[value].inverted;
     value = config->devices[value].inverted;
-    return (bool)(getParent()->contentCount() - index -1);
+    return (bool)(tag.getParent()->contentCount() - index -1);
   }
   
-  bool contentsSave(const String& content){
+  static bool contentsSave(TagBase& tag, const String& content){
     /*Serial.print("TagIoInverted.contentsSave(");
     Serial.print(content);
     Serial.println(")");*/
 
     // Not every config->devices entry is populated.
-    uint8_t value = config->labelToIndex(sequence);
+    uint8_t value = config->labelToIndex(tag.sequence);
     
     config->devices[value].inverted = content.toInt();
     return true;
   }
 };
 
-class TagIoDefault : public TagBase{
+class TagIoDefault : public TagHandler{
  public:
-  TagIoDefault(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "default"),
-                        children{ } {
-    configurable = true;
-                        }
-
-  TagBase* children[0];
-
-  bool contentsAt(uint8_t index, String& content, int& value){
+  static bool contentsAt(TagBase& tag, uint8_t index, String& content, int& value){
     // Not every config->devices entry is populated.
     value = config->labelToIndex(index);
 
     content = config->devices[value].io_default;
     value = config->devices[value].io_default;
-    return (bool)(getParent()->contentCount() - index -1);
+    return (bool)(tag.getParent()->contentCount() - index -1);
   }
   
-  bool contentsSave(const String& content){
+  static bool contentsSave(TagBase& tag, const String& content){
     /*Serial.print("TagIoDefault.contentsSave(");
     Serial.print(content);
     Serial.println(")");*/
 
     // Not every config->devices entry is populated.
-    uint8_t value = config->labelToIndex(sequence);
+    uint8_t value = config->labelToIndex(tag.sequence);
 
     config->devices[value].io_default = content.toInt();
     return true;
   }
 };
 
-class TagIo : public TagBase{
+class TagIoSampleinterval : public TagHandler{
+ public:
+  static bool contentsAt(TagBase& tag, uint8_t index, String& content, int& value){
+    // Not every config->devices entry is populated.
+    value = config->labelToIndex(index);
+
+    content = config->devices[value].io_sample_interval;
+    value = config->devices[value].io_sample_interval;
+    return (bool)(tag.getParent()->contentCount() - index -1);
+  }
+  
+  static bool contentsSave(TagBase& tag, const String& content){
+    // Not every config->devices entry is populated.
+    uint8_t value = config->labelToIndex(tag.sequence);
+
+    config->devices[value].io_sample_interval = content.toInt();
+    return true;
+  }
+};
+
+class TagIoInterval : public TagHandler{
+ public:
+  static bool contentsAt(TagBase& tag, uint8_t index, String& content, int& value){
+    // Not every config->devices entry is populated.
+    value = config->labelToIndex(index);
+
+    content = config->devices[value].io_interval;
+    value = config->devices[value].io_interval;
+    return (bool)(tag.getParent()->contentCount() - index -1);
+  }
+  
+  static bool contentsSave(TagBase& tag, const String& content){
+    // Not every config->devices entry is populated.
+    uint8_t value = config->labelToIndex(tag.sequence);
+
+    config->devices[value].io_interval = content.toInt();
+    return true;
+  }
+};
+
+class TagIoDeadband : public TagHandler{
+ public:
+  static bool contentsAt(TagBase& tag, uint8_t index, String& content, int& value){
+    // Not every config->devices entry is populated.
+    value = config->labelToIndex(index);
+
+    content = config->devices[value].io_deadband;
+    value = config->devices[value].io_deadband;
+    return (bool)(tag.getParent()->contentCount() - index -1);
+  }
+  
+  static bool contentsSave(TagBase& tag, const String& content){
+    // Not every config->devices entry is populated.
+    uint8_t value = config->labelToIndex(tag.sequence);
+
+    config->devices[value].io_deadband = content.toInt();
+    return true;
+  }
+};
+
+class TagIoIopin2 : public TagHandler{
+ public:
+  static bool contentsAt(TagBase& tag, uint8_t index, String& content, int& value){
+    // Not every config->devices entry is populated.
+    value = config->labelToIndex(index);
+
+    value = config->devices[value].iopin2;
+    if(value == IOPIN_NONE){
+      content = "none";
+    } else {
+      content = value;
+    }
+    return (bool)(tag.getParent()->contentCount() - index -1);
+  }
+  
+  static bool contentsSave(TagBase& tag, const String& content){
+    // Not every config->devices entry is populated.
+    uint8_t value = config->labelToIndex(tag.sequence);
+
+    if(content == "" || content == "none"){
+      config->devices[value].iopin2 = IOPIN_NONE;
+    } else {
+      config->devices[value].iopin2 = content.toInt();
+    }
+    return true;
+  }
+};
+
+class TagIoRatelimit : public TagHandler{
+ public:
+  static bool contentsAt(TagBase& tag, uint8_t index, String& content, int& value){
+    // Not every config->devices entry is populated.
+    value = config->labelToIndex(index);
+
+    content = config->devices[value].rate_limit;
+    value = config->devices[value].rate_limit;
+    return (bool)(tag.getParent()->contentCount() - index -1);
+  }
+  
+  static bool contentsSave(TagBase& tag, const String& content){
+    // Not every config->devices entry is populated.
+    uint8_t value = config->labelToIndex(tag.sequence);
+
+    config->devices[value].rate_limit = content.toInt();
+    return true;
+  }
+};
+
+class TagIoSuppressed : public TagHandler{
+ public:
+  static bool contentsAt(TagBase& tag, uint8_t index, String& content, int& value){
+    // Not every config->devices entry is populated.
+    value = config->labelToIndex(index);
+
+    value = io->announceSuppressed(value);
+    content = value;
+    return (bool)(tag.getParent()->contentCount() - index -1);
+  }
+};
+
+class TagIoState : public TagHandler{
+ public:
+  static bool contentsAt(TagBase& tag, uint8_t index, String& content, int& value){
+    // Not every config->devices entry is populated.
+    value = config->labelToIndex(index);
+
+    value = config->devices[value].io_value;
+    content = value;
+    return (bool)(tag.getParent()->contentCount() - index -1);
+  }
+};
+
+class TagIo : public TagHandler{
+ public:
+  static uint8_t contentCount(TagBase& /*tag*/){
+    return config->deviceCount();
+  }
+};
+
+class TagRulesInput : public TagHandler{
+ public:
+  // The index into config->devices of the device labelled content, or
+  // RULE_NO_DEVICE if there is none.
+  static uint8_t labelToDevice(const String& content){
+    if(content == "" || content == "none"){
+      return RULE_NO_DEVICE;
+    }
+    const int label = content.toInt();
+    const int index = config->labelToIndex(label);
+    if(label < 0 || index < 0 || !config->deviceInUse(index)){
+      return RULE_NO_DEVICE;
+    }
+    return index;
+  }
+
+  static bool contentsAt(TagBase& tag, uint8_t index, String& content, int& value){
+    // Not every config->rules entry is populated.
+    value = config->ruleLabelToIndex(index);
+    if(value < 0){
+      content = "";
+      value = 0;
+      return false;
+    }
+
+    // Stored as an index into config->devices but shown as the device's label.
+    value = config->indexToLabel(config->rules[value].input);
+    content = (value < 0 ? String("none") : String(value));
+    return (bool)(tag.getParent()->contentCount() - index -1);
+  }
+  
+  static bool contentsSave(TagBase& tag, const String& content){
+    // Not every config->rules entry is populated.
+    const int value = config->ruleLabelToIndex(tag.sequence);
+    if(value < 0){
+      // Every rule is in use.
+      return false;
+    }
+
+    config->rules[value].input = labelToDevice(content);
+    return true;
+  }
+};
+
+class TagRulesOutput : public TagRulesInput{
+ public:
+  static bool contentsAt(TagBase& tag, uint8_t index, String& content, int& value){
+    // Not every config->rules entry is populated.
+    value = config->ruleLabelToIndex(index);
+    if(value < 0){
+      content = "";
+      value = 0;
+      return false;
+    }
+
+    // Stored as an index into config->devices but shown as the device's label.
+    value = config->indexToLabel(config->rules[value].output);
+    content = (value < 0 ? String("none") : String(value));
+    return (bool)(tag.getParent()->contentCount() - index -1);
+  }
+  
+  static bool contentsSave(TagBase& tag, const String& content){
+    // Not every config->rules entry is populated.
+    const int value = config->ruleLabelToIndex(tag.sequence);
+    if(value < 0){
+      // Every rule is in use.
+      return false;
+    }
+
+    config->rules[value].output = labelToDevice(content);
+    return true;
+  }
+};
+
+class TagRulesTrigger : public TagHandler{
+ public:
+  static bool contentsAt(TagBase& tag, uint8_t index, String& content, int& value){
+    // Not every config->rules entry is populated.
+    value = config->ruleLabelToIndex(index);
+    if(value < 0){
+      content = "";
+      value = 0;
+      return false;
+    }
+
+    content = TriggerToString(config->rules[value].trigger);
+    value = config->rules[value].trigger;
+    return (bool)(tag.getParent()->contentCount() - index -1);
+  }
+  
+  static bool contentsSave(TagBase& tag, const String& content){
+    // Not every config->rules entry is populated.
+    const int value = config->ruleLabelToIndex(tag.sequence);
+    if(value < 0){
+      // Every rule is in use.
+      return false;
+    }
+
+    config->rules[value].setTrigger(content);
+    return true;
+  }
+};
+
+class TagRulesAction : public TagHandler{
  public:
-  TagIo(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "io"),
-                        children{new TagIoIndex(COMMON_PERAMS),
-                                 new TagIoTopic(COMMON_PERAMS),
-                                 new TagIoInverted(COMMON_PERAMS),
-                                 new TagIoDefault(COMMON_PERAMS),
-                                 new TagUiIopin(COMMON_PERAMS),
-                                 new TagUiIotype(COMMON_PERAMS)
-                        } {}
-  TagBase* children[6];
+  static bool contentsAt(TagBase& tag, uint8_t index, String& content, int& value){
+    // Not every config->rules entry is populated.
+    value = config->ruleLabelToIndex(index);
+    if(value < 0){
+      content = "";
+      value = 0;
+      return false;
+    }
+
+    content = ActionToString(config->rules[value].action);
+    value = config->rules[value].action;
+    return (bool)(tag.getParent()->contentCount() - index -1);
+  }
+  
+  static bool contentsSave(TagBase& tag, const String& content){
+    // Not every config->rules entry is populated.
+    const int value = config->ruleLabelToIndex(tag.sequence);
+    if(value < 0){
+      // Every rule is in use.
+      return false;
+    }
 
-  uint8_t contentCount(){
+    config->rules[value].setAction(content);
+    return true;
+  }
+};
+
+class TagRulesValue : public TagHandler{
+ public:
+  static bool contentsAt(TagBase& tag, uint8_t index, String& content, int& value){
+    // Not every config->rules entry is populated.
+    value = config->ruleLabelToIndex(index);
+    if(value < 0){
+      content = "";
+      value = 0;
+      return false;
+    }
+
+    content = config->rules[value].value;
+    value = config->rules[value].value;
+    return (bool)(tag.getParent()->contentCount() - index -1);
+  }
+  
+  static bool contentsSave(TagBase& tag, const String& content){
+    // Not every config->rules entry is populated.
+    const int value = config->ruleLabelToIndex(tag.sequence);
+    if(value < 0){
+      // Every rule is in use.
+      return false;
+    }
+
+    config->rules[value].value = content.toInt();
+    return true;
+  }
+};
+
+class TagRulesDuration : public TagHandler{
+ public:
+  static bool contentsAt(TagBase& tag, uint8_t index, String& content, int& value){
+    // Not every config->rules entry is populated.
+    value = config->ruleLabelToIndex(index);
+    if(value < 0){
+      content = "";
+      value = 0;
+      return false;
+    }
+
+    content = config->rules[value].duration;
+    value = config->rules[value].duration;
+    return (bool)(tag.getParent()->contentCount() - index -1);
+  }
+  
+  static bool contentsSave(TagBase& tag, const String& content){
+    // Not every config->rules entry is populated.
+    const int value = config->ruleLabelToIndex(tag.sequence);
+    if(value < 0){
+      // Every rule is in use.
+      return false;
+    }
+
+    config->rules[value].duration = content.toInt();
+    return true;
+  }
+};
+
+class TagRules : public TagHandler{
+ public:
+  static uint8_t contentCount(TagBase& /*tag*/){
     uint8_t count = 0;
-    for(int i = 0; i < MAX_DEVICES; ++i) {
-      if(strlen(config->devices[i].address_segment[0].segment) > 0) {
+    for(int i = 0; i < MAX_RULES; ++i) {
+      if(config->rules[i].action != action_none) {
         count ++;
       }
     }
@@ -1785,71 +2132,82 @@ class TagIo : public TagBase{
   }
 };
 
-class TagRoot : public TagBase{
- public:
-  TagRoot(COMMON_DEF) : TagBase(children, CHILDREN_LEN, COMMON_PERAMS, "root"), 
-                        children{new TagHost(COMMON_PERAMS),
-                                 new TagSession(COMMON_PERAMS),
-                                 new TagServers(COMMON_PERAMS),
-                                 new TagMdns(COMMON_PERAMS),
-                                 new TagFs(COMMON_PERAMS),
-                                 new TagIo(COMMON_PERAMS)
-                        } {}
-  TagBase* children[6];
-};
-
 
 class TagItterator{
  public: 
-  TagItterator(TagRoot& tagRoot) {
+  TagItterator() {
     for(uint8_t i = 0; i < MAX_TAG_RECURSION; i++){
       tag[i] = nullptr;
     }
-    tag[0] = &tagRoot;
+    tag[0] = &tags[tag_root];
     reset();
     last_loop = true;
   }
 
+  // Whether every tag has been returned by loop().
+  bool done() const {
+    return last_loop;
+  }
+
+  // tag_generation when reset() was last called.
+  uint32_t startGeneration() const {
+    return start_generation;
+  }
+
+  // Generation passed to reset(). 0 if no tags are skipped.
+  uint32_t sinceGeneration() const {
+    return since;
+  }
+
   TagBase* getByPath(const String& path){
-    /*Serial.print("getByPath(");
-    Serial.print(path);
-    Serial.println(")");*/
+    return getByPath(path.c_str());
+  }
 
-    uint8_t path_pointer_head = 0;
-    uint8_t path_pointer_tail = 0;
+  // Each "." separated segment of path is either a child's name or the
+  // sequence of the next named segment.
+  TagBase* getByPath(const char* path){
     TagBase* tag_pointer = tag[0];
     uint8_t sequence = 0;
-    while(path_pointer_tail < path.length()){
-      path_pointer_head = path_pointer_tail;
-      path_pointer_tail = path.indexOf(".", path_pointer_head) +1;
-      if(path_pointer_tail == 0){
-        path_pointer_tail = path.length() +1;
+    while(*path != '\0'){
+      const char* segment_end = strchr(path, '.');
+      if(segment_end == nullptr){
+        segment_end = path + strlen(path);
+      }
+
+      bool numeric = (segment_end > path);
+      uint16_t number = 0;
+      for(const char* c = path; c < segment_end; c++){
+        if(*c < '0' || *c > '9'){
+          numeric = false;
+          break;
+        }
+        number = number * 10 + (*c - '0');
       }
 
-      if(path.substring(path_pointer_head, path_pointer_tail -1).toInt() ||
-          path.substring(path_pointer_head, path_pointer_tail -1) == "0")
-      {
-        sequence = path.substring(path_pointer_head, path_pointer_tail -1).toInt();
+      if(numeric){
+        sequence = number;
       } else {
-        TagBase* child;
-        uint8_t i = 0;
-        while(i < tag_pointer->children_len && (child = tag_pointer->getChild(i))){
-          if(child != nullptr &&
-              String(child->name) == path.substring(path_pointer_head, path_pointer_tail -1))
-          {
-            tag_pointer = child;
-            tag_pointer->sequence = sequence;
-            sequence = 0;
-            break;
-          }
-          i++;
+        TagBase* child = tag_pointer->findChild(path, segment_end - path);
+        if(child != nullptr){
+          tag_pointer = child;
+          tag_pointer->sequence = sequence;
+          sequence = 0;
         }
       }
+
+      path = (*segment_end == '.') ? segment_end +1 : segment_end;
     }
     return tag_pointer;
   }
 
-  void reset(){
+  // If since is set loop() skips every tag not changed after that generation.
+  // If pattern is set loop() only returns tags whose path matches it segment
+  // by segment, "*" matching any one segment. Branches that cannot match are
+  // not walked. pattern must outlive the walk.
+  void reset(const uint32_t since_=0, const char* pattern_=nullptr){
+    since = since_;
+    pattern = pattern_;
+    start_generation = tag_generation;
     count[0] = 0;
     last_loop = false;
     for(uint8_t i = 1; i < MAX_TAG_RECURSION; i++){
@@ -1864,7 +2222,7 @@ class TagItterator{
     if(child == nullptr){
       return parent->getChild(0);
     }
-    for(uint8_t sibling = 0; sibling < parent->children_len -1; sibling++){
+    for(uint8_t sibling = 0; sibling < parent->children_len() -1; sibling++){
       if(parent->getChild(sibling) == child){
         return parent->getChild(sibling +1);
       }
@@ -1874,45 +2232,79 @@ class TagItterator{
 
   TagBase* loop(uint8_t* p_depth = nullptr){
     uint8_t depth = 0;
+    TagBase* return_tag = nullptr;
 
-    if(last_loop){
-      if(p_depth != nullptr){
-        *p_depth = 0;
+    while(return_tag == nullptr){
+      if(last_loop){
+        if(p_depth != nullptr){
+          *p_depth = 0;
+        }
+        return nullptr;
       }
-      return nullptr;
-    }
 
+      for(depth = 0; depth < MAX_TAG_RECURSION; depth++){
+        if(tag[depth] == nullptr){
+          depth--;
+          break;
+        }
+      }
 
-    for(depth = 0; depth < MAX_TAG_RECURSION; depth++){
-      if(tag[depth] == nullptr){
-        depth--;
-        break;
+      // Anything may have moved the sequences of the tags above since the last
+      // call, eg. tagByPathId().
+      for(uint8_t d = 1; d <= depth; d++){
+        tag[d]->sequence = count[d -1];
       }
-    }
 
-    TagBase* return_tag = tag[depth];
-    return_tag->sequence = count[depth -1];
+      // An unchanged tag has nothing changed below it either.
+      bool skip = (since > 0 && tag[depth]->generation <= since);
+      // Whether anything below this tag could be returned.
+      bool descend = !skip;
+      if(!skip){
+        const int8_t match = (pattern == nullptr ? 0 : matchPattern(depth));
+        if(match < 0){
+          skip = true;
+          descend = false;
+        } else if(match > 0){
+          // Anything below has a longer path than pattern.
+          descend = false;
+        }
+        if(!skip && (pattern == nullptr || match > 0)){
+          return_tag = tag[depth];
+        }
+      }
 
-    if(tag[depth]->children_len > 0){
-      tag[depth +1] = tag[depth]->getChild(0);
-      count[depth +1] = 0;
-    } else {
-      uint8_t d = depth +1;
-      while(tag[d] == nullptr){
-        d--;
-        
-        if(d == 0){
-          last_loop = true;
-          break;
+      if(descend && tag[depth]->children_len() > 0){
+        tag[depth +1] = tag[depth]->getChild(0);
+        count[depth +1] = 0;
+      } else {
+        uint8_t d = depth +1;
+        if(skip || (pattern != nullptr && !descend)){
+          // Straight on to the next sibling, without counting a list there
+          // is no need to walk.
+          d = depth;
+          if(d == 0){
+            last_loop = true;
+          } else {
+            count[d] = 0;
+            tag[d] = getSibling(tag[d -1], tag[d]);
+          }
         }
+        while(d > 0 && tag[d] == nullptr){
+          d--;
+        
+          if(d == 0){
+            last_loop = true;
+            break;
+          }
           
-        count[d]++;
-        if(count[d] < tag[d]->contentCount()){
-          break;
-        }
-        count[d] = 0;
+          count[d]++;
+          if(count[d] < tag[d]->contentCount()){
+            break;
+          }
+          count[d] = 0;
         
-        tag[d] = getSibling(tag[d -1], tag[d]);
+          tag[d] = getSibling(tag[d -1], tag[d]);
+        }
       }
     }
 
@@ -1924,120 +2316,278 @@ class TagItterator{
   }
 
  private:
+  // Consume the next "." separated segment of p if it matches segment.
+  static bool matchSegment(const char*& p, const char* segment){
+    if(*p == '\0'){
+      return false;
+    }
+    const char* end = strchr(p, '.');
+    if(end == nullptr){
+      end = p + strlen(p);
+    }
+    const bool match = (end - p == 1 && *p == '*') ||
+                       ((size_t)(end - p) == strlen(segment) &&
+                        strncmp(p, segment, end - p) == 0);
+    p = (*end == '.') ? end +1 : end;
+    return match;
+  }
+
+  // Compare the path of tag[depth] with pattern, a segment at a time as
+  // TagBase::getPath() would render it.
+  // -1 if neither it nor anything below it can match. 0 if only tags below
+  // it might. 1 if it matches.
+  int8_t matchPattern(const uint8_t depth) const {
+    const char* p = pattern;
+    for(uint8_t d = 1; d <= depth; d++){
+      if(tag[d -1]->hasContents()){
+        char number[4];
+        snprintf(number, sizeof(number), "%u", (uint8_t)count[d -1]);
+        if(!matchSegment(p, number)){
+          return -1;
+        }
+      }
+      char name[TAG_NAME_LEN];
+      strncpy_P(name, tag_nodes[tag[d]->id()].name, TAG_NAME_LEN);
+      if(!matchSegment(p, name)){
+        return -1;
+      }
+    }
+    return (*p == '\0') ? 1 : 0;
+  }
+
   TagBase* tag[MAX_TAG_RECURSION];
   int8_t count[MAX_TAG_RECURSION];
   std::function< void(String&, String&) > callback;
   bool last_loop;
+  uint32_t since;
+  const char* pattern;
+  uint32_t start_generation;
 };
 
+// Tags waiting to be sent by learn_all, in the order the itterator found them.
+// Sent as numbered "teach_frame"s with up to TaqQueue::window frames
+// unacknowledged at once, like a TCP sliding window.
 struct TagQueueEntry{
-  uint16_t id;
-  uint8_t sequence;
-  TagBase* tag;
+  uint32_t path_id;
+  uint32_t frame;  // Frame carrying the entry, TAG_ENTRY_UNSENT or TAG_ENTRY_DONE.
+};
+
+#define TAG_ENTRY_UNSENT 0
+#define TAG_ENTRY_DONE 0xFFFFFFFF
+
+#define TAG_FRAME_ACKED 0x01
+#define TAG_FRAME_RETRANSMITTED 0x02  // No RTT sample from this frame. (Karn)
+#define TAG_FRAME_LOST 0x04           // Retransmit without waiting for the RTO.
+
+// A frame sent but not yet acknowledged.
+struct TagFrame{
+  uint32_t frame;
   unsigned long sent_at;
+  uint8_t start;  // First entry in TaqQueue::queue.
+  uint8_t len;    // Entries from start, including ones dropped since.
+  uint8_t flags;
 };
 
-#define TAG_QUEUE_LEN 20
+#define TAG_QUEUE_LEN 64
+
+// Largest "teach_frame" sent during learn_all. As many queued tags as fit are
+// packed into each frame. Kept below lwIP's 1460 byte TCP MSS.
+#define TAG_FRAME_LEN 1024
+
+// Most frames unacknowledged at once.
+#define TAG_WINDOW_MAX 8
+
+// Retransmit timeout bounds in milliseconds.
+#define TAG_RTO_INIT 1000
+#define TAG_RTO_MIN 200
+#define TAG_RTO_MAX 10000
+
+// A frame is presumed lost once this many later frames have been acknowledged.
+#define TAG_DUP_THRESHOLD 3
 
 class TaqQueue{
  public:
-  TaqQueue() {
+  TaqQueue() : next_frame(1), window(2), srtt(0), rttvar(0), rto(TAG_RTO_INIT) {
     clear();
   }
 
-  void clear(){
-    for(uint8_t i=0; i < TAG_QUEUE_LEN; i++){
-      queue[i].id = 0;
-    }
+  // session is sent with every frame so acks can be told apart.
+  void clear(const uint32_t session_=0){
+    session = session_;
+    tail = 0;
+    used = 0;
+    sent = 0;
+    base = next_frame;
+    window_acks = 0;
   }
 
   void dequeue(TagBase* tag){
     if(tag == nullptr){
       return;
     }
+    dequeue(tag->pathId());
+  }
 
-    for(uint8_t i=0; i < TAG_QUEUE_LEN; i++){
-      if(tag == queue[i].tag){
-        Serial.print("TaqQueue::dequeue(");
-        Serial.print(tag->id);
-        Serial.println(")   (tag)");
+  // Only the bits of path_id set in mask need match.
+  void dequeue(const uint32_t path_id, const uint32_t mask=0xFFFFFFFF);
 
-        queue[i].id = 0;
-      }
-    }
-  }
+  // Every frame up to and including cumulative has arrived, as has frame
+  // cumulative +2 +n for each bit n set in sack.
+  void ack(const uint32_t cumulative, const uint32_t sack);
 
-  void dequeue(uint16_t id, uint8_t sequence){
-    for(uint8_t i=0; i < TAG_QUEUE_LEN; i++){
-      if(id == queue[i].id && sequence == queue[i].sequence){
-        Serial.print("TaqQueue::dequeue()");
-        Serial.print(i);
-        Serial.print(" ");
-        Serial.print(id);
-        Serial.print(" ");
-        Serial.print(queue[i].tag->getPath());
-        Serial.println("   (id)");
+  bool full() const {
+    return used == TAG_QUEUE_LEN;
+  }
 
-        queue[i].id = 0;
-      }
-    }
+  bool empty() const {
+    return used == 0;
   }
 
   bool push(TagBase* tag){
-    if(tag == nullptr){
+    if(tag == nullptr || full()){
       return false;
     }
+    TagQueueEntry& entry = queue[(tail + used) % TAG_QUEUE_LEN];
+    entry.path_id = tag->pathId();
+    entry.frame = TAG_ENTRY_UNSENT;
+    used++;
+    return true;
+  }
 
-    for(uint8_t i=0; i < TAG_QUEUE_LEN; i++){
-      if(queue[i].id == tag->id && queue[i].sequence == tag->sequence){
-        // Already in queue.
-        return true;
-      }
-    }
+  // Send one "teach_frame": a lost or timed out frame again, or otherwise as
+  // many unsent entries as fit in TAG_FRAME_LEN bytes if the window allows.
+  // Returns false if nothing was sent.
+  bool sendFrame(std::function< void(String&, String&) > callback);
 
-    for(uint8_t i=0; i < TAG_QUEUE_LEN; i++){
-      if(queue[i].id == 0){
-        Serial.print("TaqQueue::push() ");
-        Serial.print(i);
-        Serial.print(" ");
-        Serial.print(tag->id);
-        Serial.print(" ");
-        Serial.println(tag->getPath());
-
-        queue[i].id = tag->id;
-        queue[i].sequence = tag->sequence;
-        queue[i].tag = tag;
-        queue[i].sent_at = 0;
-        return true;
-      }
-    }
-    return false;
+ private:
+  TagFrame& frameRecord(const uint32_t frame){ return frames[frame % TAG_WINDOW_MAX]; }
+  void ackFrame(TagFrame& record, const bool sample);
+  void rttSample(const uint32_t rtt);
+  void advance();
+  bool render(TagFrame& record, String& frame);
+  void transmit(TagFrame& record, String& frame,
+                std::function< void(String&, String&) > callback);
+
+  TagQueueEntry queue[TAG_QUEUE_LEN];
+  uint8_t tail;        // Oldest entry not yet acknowledged.
+  uint8_t used;        // Entries from tail.
+  uint8_t sent;        // Entries from tail that have been put in a frame.
+  TagFrame frames[TAG_WINDOW_MAX];
+  uint32_t base;       // Oldest frame not yet acknowledged.
+  uint32_t next_frame;
+  uint8_t window;      // Frames allowed unacknowledged. Additive increase,
+                       // multiplicative decrease.
+  uint8_t window_acks; // Frames acknowledged since window last grew.
+  uint32_t srtt;       // Smoothed round trip time. 0 until the first sample.
+  uint32_t rttvar;
+  uint32_t rto;
+  uint32_t session;
+};
+
+// Where a command arrived from. State kept per client (subscriptions, sync
+// sessions) is kept per transport. Every websocket client shares one
+// transport as replies are broadcast to them all.
+enum Transport : uint8_t {
+  transport_websocket,
+  transport_mqtt
+};
+
+const uint8_t TRANSPORT_COUNT = 2;
+
+// One transport's learn_all: its own itterator, window of frames and callback,
+// so clients on different transports do not restart each other.
+class TagSyncSession{
+ public:
+  TagSyncSession() : id(0), heard_at(0) {}
+
+  bool active() const {
+    return id != 0;
   }
 
-  TagBase* peek(){
-    //Serial.println("TaqQueue::peek()");
+  void start(const uint32_t id_, const uint32_t since,
+             std::function< void(String&, String&) > callback_){
+    id = id_;
+    itterator.reset(since);
+    queue.clear(id);
+    callback = callback_;
+    heard_at = millis();
+  }
 
-    for(uint8_t i=0; i < TAG_QUEUE_LEN; i++){
-      if(queue[i].id != 0 && (millis() - queue[i].sent_at > 10000)){
-        if(queue[i].id != queue[i].tag->id){
-          Serial.printf("NO MATCH: %i %i %i\n", queue[i].id, queue[i].tag->id, i);
-        }
-        queue[i].sent_at = millis();
-        Serial.print("TaqQueue::peek()  ");
-        Serial.print(i);
-        Serial.print(" ");
-        Serial.print(queue[i].id);
-        Serial.print(" ");
-        Serial.println(queue[i].tag->getPath());
-        queue[i].tag->sequence = queue[i].sequence;
-        return queue[i].tag;
-      }
-    }
-    return nullptr;
+  void stop(){
+    id = 0;
+    queue.clear();
+    callback = nullptr;
   }
 
+  void ack(const uint32_t cumulative, const uint32_t sack){
+    queue.ack(cumulative, sack);
+    heard_at = millis();
+  }
+
+  void dequeue(const uint32_t path_id, const uint32_t mask){
+    queue.dequeue(path_id, mask);
+  }
+
+  // Send this session's next frame, or "teach_done" once every tag is
+  // acknowledged. Returns false if there was nothing to send.
+  bool loop();
+
+  uint32_t id;  // 0 if the session is free.
+
  private:
-  TagQueueEntry queue[TAG_QUEUE_LEN];
-};
+  TagItterator itterator;
+  TaqQueue queue;
+  std::function< void(String&, String&) > callback;
+  unsigned long heard_at;
+};
+
+// One per transport. A learn_all replaces any session already running on the
+// same transport; its replies are broadcast to the same clients anyway.
+#define TAG_SYNC_SESSIONS TRANSPORT_COUNT
+#define TAG_SYNC_TIMEOUT 60000  // Milliseconds without an ack before a session is dropped.
+
+// Start a learn_all, or a learn_since if since is set, in transport's session.
+void tagSyncStart(const uint32_t since, const Transport transport,
+                  std::function< void(String&, String&) > callback);
+void tagSyncAck(const uint32_t session, const uint32_t cumulative, const uint32_t sack);
+// For clients that ack single tags. Applies to every session.
+void tagSyncDequeue(const uint32_t path_id, const uint32_t mask=0xFFFFFFFF);
+// Give the next session with anything to send its turn. Call from loop().
+void tagSyncLoop();
+
+// A client's interest in the tags whose path matches pattern. Each "." separated
+// segment of pattern must equal the same segment of the path, or be "*" to match
+// any one segment. eg. "io.*.state".
+// Changed tags are pushed in a "notify" at most every interval milliseconds.
+// A subscription is identified by its pattern and transport, and lapses after
+// TAG_SUBSCRIBE_TTL unless renewed.
+struct TagSubscription{
+  char pattern[TAG_PATH_LEN];  // Empty if unused.
+  Transport transport;
+  uint16_t interval;
+  uint32_t generation;         // Changes up to this generation have been pushed.
+  unsigned long pushed_at;
+  unsigned long renewed_at;
+  std::function< void(String&, String&) > callback;
+  // A push in progress. It sends one "notify" per loop().
+  bool pushing;
+  TagItterator itterator;
+  uint32_t held_path_id;       // Tag that did not fit the last "notify". 0 if none.
+};
+
+#define TAG_SUBSCRIPTIONS_PER_TRANSPORT 3
+#define TAG_SUBSCRIPTIONS (TAG_SUBSCRIPTIONS_PER_TRANSPORT * TRANSPORT_COUNT)
+#define TAG_SUBSCRIBE_TTL 300000  // Milliseconds.
+
+// Add or renew transport's subscription to pattern. Every matching tag is
+// pushed once, starting on the next pushSubscriptions().
+// Returns false if transport already has TAG_SUBSCRIPTIONS_PER_TRANSPORT.
+bool tagSubscribe(const char* pattern, const uint16_t interval, const Transport transport,
+                  std::function< void(String&, String&) > callback);
+void tagUnsubscribe(const char* pattern, const Transport transport);
+
+// Push changed tags to any subscription that is due, one "notify" per
+// subscription per call. Call from loop().
+void pushSubscriptions();
 
 #endif  // ESP8266__TAGS_H
@@ -51,7 +51,7 @@ void WebSocket::parseIncoming(uint8_t num, uint8_t * payload, size_t length) {
                                   //websocket.sendTXT(num, t + " : " + p);
                                 //}
                               };
-    actOnMessage(io, config, topic, (char*)payload, sendTXT_callback);
+    actOnMessage(io, config, topic, (char*)payload, sendTXT_callback, transport_websocket);
   }
 }
 
@@ -65,6 +65,18 @@ void WebSocket::publish(String& topic, String& payload){
   websocket.broadcastTXT(topic + " : " + payload);
 }
 
+void WebSocket::publish(const char* topic, const char* payload){
+  Serial.print("wsPublish(");
+  Serial.print(topic);
+  Serial.print(", ");
+  Serial.print(payload);
+  Serial.println(")");
+
+  char buffer[MAX_TOPIC_LENGTH + ANNOUNCE_PAYLOAD_LEN + 4];
+  snprintf(buffer, sizeof(buffer), "%s : %s", topic, payload);
+  websocket.broadcastTXT(buffer);
+}
+
 void WebSocket::onEvent(uint8_t num, WStype_t type, uint8_t * payload, size_t length) {
 	switch(type) {
 		case WStype_DISCONNECTED:
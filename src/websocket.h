@@ -34,6 +34,7 @@ class WebSocket{
   WebSocket(Io* io_, Config* config_);
   void parseIncoming(uint8_t num, uint8_t * payload, size_t length);
   void publish(String& topic, String& payload);
+  void publish(const char* topic, const char* payload);
   void onEvent(uint8_t num, WStype_t type, uint8_t * payload, size_t length);
   void begin(){
     websocket.begin(); 